@@ -0,0 +1,300 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/timerfd.h>
+#include "snake_game.hpp"
+
+// The termios front-end of snake_game.hpp.
+//
+//   g++ -O2 SnakeLinuxConsole.cpp -o snake
+//   ./snake [--seed N]
+
+#define SNAKE_TICK_NS 100000000     // Simulation rate, 10 ticks a second
+#define SNAKE_MAX_CATCH_UP 3        // Ticks run at once after a stall, the rest are skipped
+
+// Sends the runs CellBuffer::flush passes it, moving the cursor to each the
+// cheapest way, a relative move, a carriage return and line feed, or an
+// absolute position, and writes the frame in a single write().
+class Terminal {
+public:
+    Terminal(int width) : width(width) { out.reserve(4096); }
+
+    void run(int x, int y, const char *cells, int count)
+    {
+        char move[32];
+        int n = 0;
+
+        if (cursorY == y && cursorX >= 0 && x > cursorX) n = snprintf(move, sizeof(move), "\033[%dC", x - cursorX);
+        else if (cursorY >= 0 && y == cursorY + 1 && x == 0) n = snprintf(move, sizeof(move), "\r\n");
+        else if (cursorX != x || cursorY != y) n = snprintf(move, sizeof(move), "\033[%d;%dH", y + 1, x + 1);
+
+        out.append(move, n);
+        out.append(cells, count);
+
+        // Terminals disagree on where the cursor goes after the last column
+        cursorX = x + count < width ? x + count : -1;
+        cursorY = x + count < width ? y : -1;
+    }
+
+    void send()
+    {
+        const char *buffer = out.data();
+        size_t size = out.size();
+
+        lastBytes = size;
+        lastWrites = 0;
+        while (size > 0) {
+            ssize_t written = write(STDOUT_FILENO, buffer, size);
+            if (written < 0) {
+                cursorX = cursorY = -1;
+                break;
+            }
+            lastWrites++;
+            buffer += written;
+            size -= written;
+        }
+        out.clear();
+
+        frames++;
+        bytes += lastBytes;
+        writes += lastWrites;
+    }
+
+    int lastBytes = 0, lastWrites = 0;      // Of the last frame
+    long frames = 0, bytes = 0, writes = 0;
+
+private:
+    int width;
+    int cursorX = -1, cursorY = -1;         // Where the terminal cursor is, -1 when unknown
+    std::string out;                        // Escape stream of one frame, keeps its capacity
+};
+
+typedef enum Key { KEY_NONE, KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, KEY_QUIT } Key;
+
+// Keys arrive as bytes in whatever chunks the terminal sends, and an arrow
+// key's escape sequence can be split across reads. Bytes are kept until a
+// whole key is there, and every key in the buffer is returned in order.
+typedef struct keyparser {
+    char buffer[64];
+    int length;
+    int stale;              // A partial sequence has sat in the buffer for a whole tick
+} keyparser;
+
+void keyparser_feed(keyparser *p, const char *bytes, int count)
+{
+    p->stale = 0;
+    if (count > (int) sizeof(p->buffer) - p->length) count = sizeof(p->buffer) - p->length;
+    memcpy(p->buffer + p->length, bytes, count);
+    p->length += count;
+}
+
+static void keyparser_consume(keyparser *p, int count)
+{
+    memmove(p->buffer, p->buffer + count, p->length - count);
+    p->length -= count;
+}
+
+// Next complete key, KEY_NONE when the buffer is empty or ends in part of a
+// sequence. A partial sequence nothing was added to for a whole tick is
+// given up on, it was a bare Escape.
+Key keyparser_next(keyparser *p)
+{
+    int flush = p->stale;
+
+    while (p->length > 0) {
+        char c = p->buffer[0];
+
+        if (c != '\033') {
+            keyparser_consume(p, 1);
+            switch (c) {
+                case 'w': case 'k': return KEY_UP;
+                case 's': case 'j': return KEY_DOWN;
+                case 'a': case 'h': return KEY_LEFT;
+                case 'd': case 'l': return KEY_RIGHT;
+                case 'q': case '\003': return KEY_QUIT;      // Ctrl-C too, ISIG is off
+            }
+            continue;
+        }
+
+        if (p->length == 1 || (p->buffer[1] != '[' && p->buffer[1] != 'O')) {
+            if (p->length == 1 && !flush) return KEY_NONE;
+            keyparser_consume(p, 1);
+            continue;
+        }
+
+        // CSI or SS3: parameters, then a final byte in @ to ~, arrows are A to D
+        int end = 2;
+        while (end < p->length && (p->buffer[end] < '@' || p->buffer[end] > '~')) end++;
+        if (end == p->length) {
+            if (!flush && p->length < (int) sizeof(p->buffer)) return KEY_NONE;
+            p->length = 0;
+            return KEY_NONE;
+        }
+
+        char final = p->buffer[end];
+        keyparser_consume(p, end + 1);
+        switch (final) {
+            case 'A': return KEY_UP;
+            case 'B': return KEY_DOWN;
+            case 'C': return KEY_RIGHT;
+            case 'D': return KEY_LEFT;
+        }
+    }
+
+    return KEY_NONE;
+}
+
+// Called once per tick after taking the keys
+void keyparser_tick(keyparser *p)
+{
+    p->stale = p->length > 0;
+}
+
+double now_seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Row 0 is the status line, the board is below it
+void draw(const SnakeGame &game, CellBuffer &cells, const Terminal &terminal)
+{
+    char status[64];
+
+    for (int x = 0; x < cells.getWidth(); x++) cells.put(x, 0, '-');
+    snprintf(status, sizeof(status), "score:%d", game.score());
+    cells.text(0, 0, status);
+    snprintf(status, sizeof(status), " %d bytes %d write%s ", terminal.lastBytes, terminal.lastWrites,
+             terminal.lastWrites == 1 ? "" : "s");
+    cells.text(cells.getWidth() - strlen(status), 0, status);
+
+    game.draw(cells, 1);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t seed = (uint64_t) time(NULL) << 20 ^ getpid();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 0);
+        else {
+            fprintf(stderr, "usage: %s [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    int screenHeight = 30;
+    int screenWidth = 60;
+
+    SnakeGame game(screenWidth, screenHeight, seed);
+    CellBuffer cells(screenWidth, screenHeight + 1);
+    Terminal terminal(screenWidth);
+
+    static struct termios old_attr, new_attr;
+
+    // Save the current terminal attributes
+    tcgetattr(STDIN_FILENO, &old_attr);
+    new_attr = old_attr;
+
+    // Disable canonical mode and echo, reads never wait: poll says when there is input.
+    // Without ISIG Ctrl-C arrives as a byte and quits through the normal exit,
+    // which restores the terminal, and Ctrl-Z cannot leave it in this mode.
+    new_attr.c_lflag &= ~(ICANON | ECHO | ISIG);
+    new_attr.c_cc[VMIN] = 0;
+    new_attr.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &new_attr);
+    int stdinFlags = fcntl(STDIN_FILENO, F_GETFL);
+    int stdinIsTty = isatty(STDIN_FILENO);
+    fcntl(STDIN_FILENO, F_SETFL, stdinFlags | O_NONBLOCK);
+
+    // The tick clock, its expirations count ticks even when we fall behind
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    struct itimerspec tick = {};
+    tick.it_interval.tv_nsec = SNAKE_TICK_NS;
+    tick.it_value.tv_nsec = SNAKE_TICK_NS;
+    timerfd_settime(timer, 0, &tick, NULL);
+
+    const char *start = "\033[?25l\033[2J";
+    write(STDOUT_FILENO, start, strlen(start));
+
+    auto emit = [&](int x, int y, const char *run, int count) { terminal.run(x, y, run, count); };
+    draw(game, cells, terminal);
+    cells.flush(emit);
+    terminal.send();
+
+    keyparser keys = {};
+    struct pollfd fds[2] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { timer, POLLIN, 0 }
+    };
+    int quit = 0;
+    long ticks = 0, skipped = 0;
+    double lastTick = now_seconds(), worstLate = 0;
+
+    while (!game.over() && !quit) {
+        if (poll(fds, 2, -1) < 0) continue;
+
+        // Input: take every byte there is and queue every complete key
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            char bytes[64];
+            ssize_t count;
+
+            while ((count = read(STDIN_FILENO, bytes, sizeof(bytes))) > 0) keyparser_feed(&keys, bytes, count);
+            // With VMIN 0 a terminal also reads 0 when it is just empty, only a hangup is the
+            // end there. For a pipe or file 0 is always the end, and poll would keep reporting it.
+            if (count == 0 && (!stdinIsTty || (fds[0].revents & POLLHUP))) fds[0].fd = -1;
+        }
+
+        // Simulate: one step per tick that passed, then draw once
+        if (fds[1].revents & POLLIN) {
+            uint64_t expired = 0;
+            if (read(timer, &expired, sizeof(expired)) != sizeof(expired)) continue;
+
+            double now = now_seconds();
+            double late = now - lastTick - SNAKE_TICK_NS / 1e9 * expired;
+            if (late > worstLate) worstLate = late;
+            lastTick = now;
+
+            if (expired > SNAKE_MAX_CATCH_UP) {
+                skipped += expired - SNAKE_MAX_CATCH_UP;
+                expired = SNAKE_MAX_CATCH_UP;
+            }
+
+            for (uint64_t t = 0; t < expired && !game.over() && !quit; t++) {
+                Key key;
+                while ((key = keyparser_next(&keys)) != KEY_NONE) {
+                    if (key == KEY_QUIT) quit = 1;
+                    else game.turn(key == KEY_UP ? SNAKE_UP : key == KEY_DOWN ? SNAKE_DOWN : key == KEY_LEFT ? SNAKE_LEFT : SNAKE_RIGHT);
+                }
+                keyparser_tick(&keys);
+                game.tick();
+                ticks++;
+            }
+
+            draw(game, cells, terminal);
+            cells.flush(emit);
+            terminal.send();
+        }
+    }
+
+    fcntl(STDIN_FILENO, F_SETFL, stdinFlags);
+    tcsetattr(STDIN_FILENO, TCSANOW, &old_attr);
+    printf("\033[?25h\033[2J\033[H%s, score: %d\n", game.won() ? "You win" : "Game over", game.score());
+    printf("%ld frames, %.1f bytes and %.2f writes per frame\n", terminal.frames,
+           terminal.frames ? (double) terminal.bytes / terminal.frames : 0,
+           terminal.frames ? (double) terminal.writes / terminal.frames : 0);
+    printf("%ld ticks, %ld skipped, latest tick %.2f ms behind schedule\n", ticks, skipped, worstLate * 1e3);
+    printf("Replay the food with --seed %llu\n", (unsigned long long) seed);
+    close(timer);
+
+    return 0;
+}
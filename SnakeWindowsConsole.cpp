@@ -1,113 +1,90 @@
-#include <iostream>
-#include <list>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
 #include <chrono>
 #include <Windows.h>
-#include <thread>
+#include "snake_game.hpp"
 
 using namespace std;
 
-struct snakePart {
-    int x;
-    int y;
-};
+// The Windows console front-end of snake_game.hpp. The loop sleeps in
+// WaitForSingleObject on the console input until a key comes in or the
+// next tick is due, so it uses no CPU between the two.
+//
+//   SnakeWindowsConsole.exe [seed]
 
-enum Direction { UP, DOWN, LEFT, RIGHT };
+const chrono::milliseconds tickLength(200);
+const int maxCatchUp = 3;           // Ticks run at once after a stall, the rest are skipped
 
-int main()
+int main(int argc, char** argv)
 {
     HANDLE hConsoleBuffer = CreateConsoleScreenBuffer(GENERIC_READ | GENERIC_WRITE, 0, NULL, CONSOLE_TEXTMODE_BUFFER, NULL);
+    HANDLE hInput = GetStdHandle(STD_INPUT_HANDLE);
 
     SetConsoleActiveScreenBuffer(hConsoleBuffer);
     SetConsoleOutputCP(CP_UTF8);
+    SetConsoleMode(hInput, 0);
 
     int screenHeight = 30;
     int screenWidth = 120;
 
-    DWORD numOfBytesWritten = 0;
-
-    list<snakePart> snake = { {40, 15}, {41, 15}, {42, 15}, {43, 15}, {44, 15}, {45, 15} };
-
-    wchar_t* screen = new wchar_t[screenHeight * screenWidth];
-
-    Direction snakeDirection = RIGHT;
-    Direction oldSnakeDirection = snakeDirection;
-
-    int foodX = 40;
-    int foodY = 10;
-
-    int score = 0;
-
-    while (1) {
-        
-        auto lstFrameTime = chrono::system_clock::now();
-
-        // Handle keys
-        while ((chrono::system_clock::now() - lstFrameTime) < 200ms) {
-            if (GetAsyncKeyState(VK_UP) & 0x8000 && oldSnakeDirection != DOWN) {
-                snakeDirection = UP;
-            }
-            if (GetAsyncKeyState(VK_DOWN) & 0x8000 && oldSnakeDirection != UP) {
-                snakeDirection = DOWN;
-            }
-            if (GetAsyncKeyState(VK_LEFT) & 0x8000 && oldSnakeDirection != RIGHT) {
-                snakeDirection = LEFT;
-            }
-            if (GetAsyncKeyState(VK_RIGHT) & 0x8000 && oldSnakeDirection != LEFT) {
-                snakeDirection = RIGHT;
-            }
-
-            oldSnakeDirection = snakeDirection;
-        }
-
-        switch (snakeDirection) {
-            case UP:
-                snake.push_front({ snake.front().x, snake.front().y - 1 });
-                break;
-            case DOWN:
-                snake.push_front({ snake.front().x, snake.front().y + 1 });
-                break;
-            case LEFT:
-                snake.push_front({ snake.front().x - 1, snake.front().y });
-                break;
-            case RIGHT:
-                snake.push_front({ snake.front().x + 1, snake.front().y });
-                break;
-        }
-
-        snake.pop_back();
-
-        // Detection
-        if (snake.front().x == foodX && snake.front().y == foodY) {
-            score++;
-
-            foodX = rand() % screenWidth;
-            foodY = rand() % screenHeight;
-
-            for (int i = 0; i < 3; i++) {
-                snake.push_back({ snake.back().x, snake.back().y });
+    DWORD numOfCellsWritten = 0;
+
+    // Row 0 is the score, the board is below it
+    SnakeGame game(screenWidth, screenHeight - 1, argc > 1 ? strtoull(argv[1], NULL, 0) : uint64_t(time(NULL)));
+    CellBuffer cells(screenWidth, screenHeight);
+
+    auto emit = [&](int x, int y, const char* run, int count) {
+        WriteConsoleOutputCharacterA(hConsoleBuffer, run, count, { SHORT(x), SHORT(y) }, &numOfCellsWritten);
+    };
+
+    auto nextTick = chrono::steady_clock::now() + tickLength;
+    bool quit = false;
+
+    while (!game.over() && !quit) {
+        auto now = chrono::steady_clock::now();
+        // Rounded up: a wait cut short to the millisecond below would wake early
+        // and spin through the last fraction of the tick with zero timeouts
+        auto left = nextTick - now + chrono::milliseconds(1) - chrono::steady_clock::duration(1);
+        DWORD wait = now < nextTick ? DWORD(chrono::duration_cast<chrono::milliseconds>(left).count()) : 0;
+
+        // Handle keys, every one pressed since the last look, in order
+        if (WaitForSingleObject(hInput, wait) == WAIT_OBJECT_0) {
+            INPUT_RECORD records[32];
+            DWORD count = 0;
+
+            ReadConsoleInput(hInput, records, 32, &count);
+            for (DWORD i = 0; i < count; i++) {
+                if (records[i].EventType != KEY_EVENT || !records[i].Event.KeyEvent.bKeyDown) continue;
+
+                switch (records[i].Event.KeyEvent.wVirtualKeyCode) {
+                    case VK_UP: game.turn(SNAKE_UP); break;
+                    case VK_DOWN: game.turn(SNAKE_DOWN); break;
+                    case VK_LEFT: game.turn(SNAKE_LEFT); break;
+                    case VK_RIGHT: game.turn(SNAKE_RIGHT); break;
+                    case VK_ESCAPE: quit = true; break;
+                }
             }
         }
 
-        // Draw
-        for (int i = 0; i < screenHeight * screenWidth; i++) {
-            screen[i] = L' ';
-        }
+        // One step per tick that passed, then draw once
+        now = chrono::steady_clock::now();
+        if (now < nextTick) continue;
 
-        for (int i = 0; i < screenWidth; i++) {
-            screen[i] = L'=';
-            screen[i + screenWidth*2] = L'=';
+        int ticks = 0;
+        for (; nextTick <= now; nextTick += tickLength) {
+            if (ticks++ < maxCatchUp && !game.over()) game.tick();
         }
-        wsprintf(&screen[screenWidth], L"Score: %d", score);
 
-
-        for (auto s : snake) {
-            screen[s.y * screenWidth + s.x] = L'o';
-        }
-
-        screen[snake.front().y * screenWidth + snake.front().x] = L'@';
-
-        screen[foodY * screenWidth + foodX] = L'X';
-
-        WriteConsoleOutputCharacter(hConsoleBuffer, screen, screenHeight * screenWidth, { 0, 0 }, &numOfBytesWritten);
+        char score[32];
+        snprintf(score, sizeof(score), "Score: %d", game.score());
+        cells.clear('=');
+        cells.text(0, 0, score);
+        game.draw(cells, 1);
+        cells.flush(emit);
     }
+
+    SetConsoleActiveScreenBuffer(GetStdHandle(STD_OUTPUT_HANDLE));
+    printf("%s, score: %d\n", game.won() ? "You win" : "Game over", game.score());
 }
@@ -1,4 +1,5 @@
 #include <c64.h>
+#include "plot.h"
 
 #define BITMAP ((unsigned char *)0x2000)
 #define SCREEN ((unsigned char *)0x0400)
@@ -12,17 +13,20 @@ typedef struct {
     int height;
 } screen;
 
+// Sets the pixel when val is non-zero, clears it otherwise. Points off the
+// screen are ignored. Call PlotInit(BITMAP) first.
 void SetPixel(screen *screen, int x, int y, char val)
 {
-    int offset;
+    if ((unsigned int) x >= (unsigned int) screen->width || (unsigned int) y >= (unsigned int) screen->height) return;
 
-    offset = (y / 8) * screen->width + (y % 8) + (x / 8) * 8;
-    SCREEN[offset] = val;
+    if (val) Plot(x, y);
+    else Unplot(x, y);
 }
 
 void main()
 {
     int b;
+    screen screen = { PLOT_WIDTH, PLOT_HEIGHT };
 
     VIC.ctrl1 = 0x3B;      // Bitmap mode (BMM=1, ECM=0)
     VIC.addr = 0x18;       // Bitmap at $2000, screen at $0400
@@ -38,6 +42,18 @@ void main()
     for (b=0; b < 8; b++) {
         BITMAP[b] = font_A[b];
     }
+
+    // A frame round the screen and a diagonal through it
+    PlotInit(BITMAP);
+    for (b = 0; b < PLOT_WIDTH; b++) {
+        SetPixel(&screen, b, 0, 1);
+        SetPixel(&screen, b, PLOT_HEIGHT - 1, 1);
+    }
+    for (b = 0; b < PLOT_HEIGHT; b++) {
+        SetPixel(&screen, 0, b, 1);
+        SetPixel(&screen, PLOT_WIDTH - 1, b, 1);
+        SetPixel(&screen, b + (PLOT_WIDTH - PLOT_HEIGHT) / 2, b, 1);
+    }
     
     // unsigned int bitmap = 0x2000;
     // *(unsigned char *)bitmap = 0x20;
@@ -0,0 +1,28 @@
+#include "plot.h"
+
+unsigned char plotRowLow[PLOT_HEIGHT];
+unsigned char plotRowHigh[PLOT_HEIGHT];
+const unsigned char plotBitMask[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+void __fastcall__ PlotInit(unsigned char *bitmap)
+{
+    unsigned char y;
+    unsigned int row;
+
+    // Stepping the address avoids a multiplication per line: +1 inside a
+    // cell, on to the next 320 byte row of cells after every eighth line
+    row = (unsigned int) bitmap;
+    for (y = 0; y < PLOT_HEIGHT; y++) {
+        plotRowLow[y] = (unsigned char) row;
+        plotRowHigh[y] = (unsigned char) (row >> 8);
+        row += (y & 7) == 7 ? 320 - 7 : 1;
+    }
+}
+
+void __fastcall__ PlotC(unsigned int x, unsigned char y)
+{
+    unsigned char *p;
+
+    p = (unsigned char *) (plotRowLow[y] | ((unsigned int) plotRowHigh[y] << 8)) + (x & 0xFFF8);
+    *p |= plotBitMask[(unsigned char) x & 7];
+}
@@ -0,0 +1,35 @@
+#ifndef PLOT_H
+#define PLOT_H
+
+// Hires bitmap plotting. The bitmap is 25 rows of 40 cells, each cell 8
+// bytes top to bottom, so pixel x, y lives in the byte at
+//
+//   (y / 8) * 320 + (y & 7) + (x & ~7)
+//
+// as bit 0x80 >> (x & 7). PlotInit works the y part out once per line into
+// plotRowLow/plotRowHigh, which leaves a plot with one 16-bit add and a
+// bitmask lookup instead of a division and a multiplication.
+//
+//   Plot, Unplot   plot.s, the fast path
+//   PlotC          the same in C, for reference and the benchmark
+//   PLOT           inline C, no call overhead in inner loops
+
+#define PLOT_WIDTH 320
+#define PLOT_HEIGHT 200
+
+extern unsigned char plotRowLow[PLOT_HEIGHT];
+extern unsigned char plotRowHigh[PLOT_HEIGHT];
+extern const unsigned char plotBitMask[8];
+
+void __fastcall__ PlotInit(unsigned char *bitmap);
+
+// x < PLOT_WIDTH and y < PLOT_HEIGHT, nothing is clipped
+void __fastcall__ Plot(unsigned int x, unsigned char y);
+void __fastcall__ Unplot(unsigned int x, unsigned char y);
+void __fastcall__ PlotC(unsigned int x, unsigned char y);
+
+// x and y are evaluated more than once
+#define PLOT(x, y) \
+    (*((unsigned char *) (plotRowLow[y] | ((unsigned int) plotRowHigh[y] << 8)) + ((x) & 0xFFF8)) |= plotBitMask[(unsigned char) (x) & 7])
+
+#endif
@@ -0,0 +1,52 @@
+;
+; Fast hires plot, see plot.h
+;
+; void __fastcall__ Plot (unsigned int x, unsigned char y);
+; void __fastcall__ Unplot (unsigned int x, unsigned char y);
+;
+; y arrives in A and x on the C stack. Counted by hand about 60 cycles from
+; the jsr to the rts plus 30 or so in popax, where the division and
+; multiplication version spends well over a thousand.
+;
+
+        .export         _Plot, _Unplot
+        .import         _plotRowLow, _plotRowHigh, _plotBitMask
+        .import         popax
+        .importzp       ptr1, tmp1
+
+; ptr1 = row base of y + (x & $FFF8), X = x & 7, Y = 0
+.macro  address
+        sta     tmp1            ; y
+        jsr     popax           ; x, low byte in A, high in X
+        stx     ptr1+1
+        tax
+        and     #$F8
+        ldy     tmp1
+        clc
+        adc     _plotRowLow,y
+        sta     ptr1
+        lda     ptr1+1
+        adc     _plotRowHigh,y
+        sta     ptr1+1
+        txa
+        and     #$07
+        tax
+        ldy     #0
+.endmacro
+
+.proc   _Plot
+        address
+        lda     _plotBitMask,x
+        ora     (ptr1),y
+        sta     (ptr1),y
+        rts
+.endproc
+
+.proc   _Unplot
+        address
+        lda     _plotBitMask,x
+        eor     #$FF
+        and     (ptr1),y
+        sta     (ptr1),y
+        rts
+.endproc
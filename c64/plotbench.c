@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "plot.h"
+
+// Cycle counts for the plot routines under sim65, which counts every cycle
+// it runs but has no VIC, so the bitmap is an ordinary array here.
+//
+//   cl65 -t sim6502 -O -Cl plotbench.c plot.c plot.s -o plotbench
+//   ./plotbench.sh
+//
+// plotbench METHOD COUNT plots COUNT points with METHOD, one of
+//
+//   none     the loop alone, subtracted from the others
+//   div      the old (y / 8) * 320 + (y % 8) + (x / 8) * 8 address
+//   c        PlotC, tables in C
+//   inline   the PLOT macro
+//   asm      Plot from plot.s
+//   check    every method against div on the whole screen, exits 1 on a difference
+//
+// and sim65 -c prints the cycles the run took.
+
+static unsigned char bitmap[8000];
+static unsigned char reference[8000];
+
+void __fastcall__ PlotDiv(unsigned int x, unsigned char y)
+{
+    bitmap[(y / 8) * 320 + (y % 8) + (x / 8) * 8] |= 0x80 >> (x % 8);
+}
+
+// Points that keep crossing cells and rows, with x on both sides of 256
+#define NEXT_POINT(x, y)                        \
+    do {                                        \
+        x += 7;                                 \
+        if (x >= PLOT_WIDTH) x -= PLOT_WIDTH;   \
+        if (++y == PLOT_HEIGHT) y = 0;          \
+    } while (0)
+
+static int check(void)
+{
+    unsigned int x;
+    unsigned char y;
+    unsigned char method;
+
+    for (y = 0; y < PLOT_HEIGHT; y += 3) {
+        for (x = 0; x < PLOT_WIDTH; x += 5) PlotDiv(x, y);
+    }
+    memcpy(reference, bitmap, sizeof(bitmap));
+
+    for (method = 0; method < 3; method++) {
+        memset(bitmap, 0, sizeof(bitmap));
+        for (y = 0; y < PLOT_HEIGHT; y += 3) {
+            for (x = 0; x < PLOT_WIDTH; x += 5) {
+                if (method == 0) PlotC(x, y);
+                else if (method == 1) PLOT(x, y);
+                else Plot(x, y);
+            }
+        }
+        if (memcmp(reference, bitmap, sizeof(bitmap)) != 0) {
+            printf("method %d plots differently\n", method);
+            return 1;
+        }
+    }
+
+    // Unplot takes back exactly what Plot set
+    for (y = 0; y < PLOT_HEIGHT; y += 3) {
+        for (x = 0; x < PLOT_WIDTH; x += 5) Unplot(x, y);
+    }
+    for (x = 0; x < sizeof(bitmap); x++) {
+        if (bitmap[x]) {
+            printf("Unplot left byte %u set\n", x);
+            return 1;
+        }
+    }
+
+    printf("all methods agree\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int x = 0, i, count;
+    unsigned char y = 0;
+    const char *method;
+
+    if (argc != 3) {
+        printf("usage: plotbench none|div|c|inline|asm|check COUNT\n");
+        return 2;
+    }
+    method = argv[1];
+    count = atoi(argv[2]);
+
+    PlotInit(bitmap);
+    if (strcmp(method, "check") == 0) return check();
+
+    if (strcmp(method, "none") == 0) {
+        for (i = 0; i < count; i++) NEXT_POINT(x, y);
+    } else if (strcmp(method, "div") == 0) {
+        for (i = 0; i < count; i++) {
+            PlotDiv(x, y);
+            NEXT_POINT(x, y);
+        }
+    } else if (strcmp(method, "c") == 0) {
+        for (i = 0; i < count; i++) {
+            PlotC(x, y);
+            NEXT_POINT(x, y);
+        }
+    } else if (strcmp(method, "inline") == 0) {
+        for (i = 0; i < count; i++) {
+            PLOT(x, y);
+            NEXT_POINT(x, y);
+        }
+    } else if (strcmp(method, "asm") == 0) {
+        for (i = 0; i < count; i++) {
+            Plot(x, y);
+            NEXT_POINT(x, y);
+        }
+    } else {
+        printf("unknown method %s\n", method);
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Cycles per plot for each method and how many fit in a frame, see plotbench.c
+set -e
+
+count=${1:-2000}
+
+# A PAL frame is 312 lines of 63 cycles, the VIC takes 40 of them on each
+# of the 25 bad lines with the screen on
+frame=$((312 * 63 - 25 * 40))
+
+cycles() {
+    sim65 -c plotbench "$1" "$count" 2>&1 | sed -n 's/^\([0-9][0-9]*\) cycles$/\1/p'
+}
+
+sim65 plotbench check 0
+
+base=$(cycles none)
+printf '%-8s %10s %16s\n' method cycles "plots per frame"
+for method in div c inline asm; do
+    total=$(cycles "$method")
+    per=$(( (total - base + count / 2) / count ))
+    printf '%-8s %10d %16d\n' "$method" "$per" $((frame / per))
+done
@@ -0,0 +1,286 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include "tinyrenderer/lib/input.h"
+#include "tinyrenderer/lib/input_trace.h"
+
+// Records and replays input traces (see tinyrenderer/lib/input_trace.h).
+//
+//   gcc -O2 inputtrace.c -o inputtrace -lm
+//
+//   ./inputtrace record FILE [SECONDS]     every input device until Ctrl-C or SECONDS
+//   ./inputtrace synth FILE SECONDS        a made up touchpad and mouse session, for
+//                                          machines without input devices
+//   ./inputtrace info FILE                 devices, frames, duration and size
+//   ./inputtrace replay FILE [--realtime]  through Input_Feed, reports the cost per
+//                                          frame and a hash of the states seen, which
+//                                          is the same on every run of the same trace
+//   ./inputtrace uinput FILE               in real time through virtual devices, so
+//                                          any program reading /dev/input gets it
+
+volatile sig_atomic_t stopping;
+
+void stop(int signal)
+{
+    stopping = 1;
+}
+
+double nowSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void ignoreFrame(const InputFrame *frame, void *user)
+{
+}
+
+int record(const char *path, double seconds)
+{
+    Input input;
+    InputTraceWriter writer;
+
+    if (Input_Init(&input) < 0 || Input_OpenDevices(&input, INPUT_ALL) == 0) {
+        fprintf(stderr, "No input devices found in /dev/input\n");
+        return -1;
+    }
+    if (InputTraceWriter_Open(&writer, path, &input) < 0) return -1;
+
+    for (int i = 0; i < input.count; i++) fprintf(stderr, "recording %s\n", input.devices[i].name);
+
+    input.tap = InputTraceWriter_Tap;
+    input.tapUser = &writer;
+    signal(SIGINT, stop);
+
+    double end = seconds > 0 ? nowSeconds() + seconds : 0;
+    while (!stopping && Input_Open(&input) > 0) {
+        int timeoutMs = end ? (int) ((end - nowSeconds()) * 1000) : -1;
+        if (end && timeoutMs <= 0) break;
+        if (Input_Poll(&input, timeoutMs, ignoreFrame, NULL) < 0) break;
+    }
+
+    printf("%ld frames, %ld events, %ld dropped\n", writer.frames, writer.events, writer.dropped);
+    Input_Destroy(&input);
+
+    return InputTraceWriter_Close(&writer);
+}
+
+static struct input_event event(int type, int code, int value)
+{
+    return (struct input_event) { .type = type, .code = code, .value = value };
+}
+
+// A finger circling on a 1920x1080 touchpad at 125 Hz, a second finger
+// joining every other second, and a mouse reporting at 1000 Hz
+int synth(const char *path, double seconds)
+{
+    Input input;
+    InputTraceWriter writer;
+
+    Input_Init(&input);
+    int pad = Input_AddDevice(&input, "synthetic touchpad", INPUT_POINTER | INPUT_TOUCH);
+    int mouse = Input_AddDevice(&input, "synthetic mouse", INPUT_POINTER);
+    input.devices[pad].info.axisX = (InputAxis) { 0, 1919 };
+    input.devices[pad].info.axisY = (InputAxis) { 0, 1079 };
+    if (InputTraceWriter_Open(&writer, path, &input) < 0) return -1;
+
+    struct input_event events[16];
+    srand(1);
+
+    for (uint64_t t = 0; t < seconds * 1000000; t += 1000) {
+        uint64_t timeUs = writer.lastUs + 1000;
+        int n = 0;
+
+        if (t % 8000 == 0) {
+            double angle = t / 1e6 * 2 * M_PI;
+            int second = (t / 1000000) % 2;
+
+            events[n++] = event(EV_ABS, ABS_MT_SLOT, 0);
+            if (t == 0) events[n++] = event(EV_ABS, ABS_MT_TRACKING_ID, 1);
+            events[n++] = event(EV_ABS, ABS_MT_POSITION_X, 960 + 400 * cos(angle));
+            events[n++] = event(EV_ABS, ABS_MT_POSITION_Y, 540 + 400 * sin(angle));
+            events[n++] = event(EV_ABS, ABS_MT_SLOT, 1);
+            if (t % 1000000 == 0) events[n++] = event(EV_ABS, ABS_MT_TRACKING_ID, second ? 2 + (int) (t / 1000000) : -1);
+            if (second) events[n++] = event(EV_ABS, ABS_MT_POSITION_X, 960 - 300 * cos(angle));
+            events[n++] = event(EV_ABS, ABS_X, 960 + 400 * cos(angle));
+            events[n++] = event(EV_ABS, ABS_Y, 540 + 400 * sin(angle));
+            events[n] = event(EV_SYN, SYN_REPORT, 0);
+            events[n].input_event_sec = timeUs / 1000000;
+            events[n].input_event_usec = timeUs % 1000000;
+            InputTraceWriter_Tap(pad, events, n + 1, &writer);
+            n = 0;
+        }
+
+        events[n++] = event(EV_REL, REL_X, rand() % 7 - 3);
+        events[n++] = event(EV_REL, REL_Y, rand() % 7 - 3);
+        if (t % 250000 == 0) events[n++] = event(EV_KEY, BTN_LEFT, (t / 250000) % 2);
+        events[n] = event(EV_SYN, SYN_REPORT, 0);
+        events[n].input_event_sec = timeUs / 1000000;
+        events[n].input_event_usec = timeUs % 1000000;
+        InputTraceWriter_Tap(mouse, events, n + 1, &writer);
+    }
+
+    printf("%ld frames, %ld events\n", writer.frames, writer.events);
+
+    return InputTraceWriter_Close(&writer);
+}
+
+int info(const char *path)
+{
+    InputTraceReader reader;
+    struct input_event events[INPUT_TRACE_FRAME_EVENTS + 1];
+    long frames = 0, eventCount = 0;
+    int device, count;
+
+    if (InputTraceReader_Open(&reader, path) < 0) return -1;
+
+    for (uint32_t i = 0; i < reader.header.devices; i++) {
+        InputTraceDevice *d = &reader.devices[i];
+        printf("device %u: %s,%s%s%s x %d..%d y %d..%d\n", i, d->name, d->capabilities & INPUT_POINTER ? " pointer" : "",
+               d->capabilities & INPUT_TOUCH ? " touch" : "", d->capabilities & INPUT_KEYBOARD ? " keyboard" : "",
+               d->axisX[0], d->axisX[1], d->axisY[0], d->axisY[1]);
+    }
+
+    while ((count = InputTraceReader_Next(&reader, &device, events)) > 0) {
+        frames++;
+        eventCount += count - 1;
+    }
+
+    long bytes = ftell(reader.file);
+    printf("%ld frames, %ld events over %.3f s, %ld bytes (%.1f per event)%s\n", frames, eventCount,
+           (reader.timeUs - reader.header.startUs) / 1e6, bytes, eventCount ? (double) bytes / eventCount : 0,
+           count < 0 ? ", damaged at the end" : "");
+    InputTraceReader_Close(&reader);
+
+    return count < 0 ? -1 : 0;
+}
+
+// FNV-1a over the state each frame ends in
+void hashFrame(const InputFrame *frame, void *user)
+{
+    uint64_t *hash = user;
+    int state[] = { frame->device->index, frame->x, frame->y, frame->dx, frame->dy, frame->wheel, frame->touches,
+                    frame->slots[0].x, frame->slots[0].y, frame->slots[1].x, frame->slots[1].y, frame->keys[BTN_LEFT / 8] };
+    const uint8_t *p = (const uint8_t *) state;
+
+    for (size_t i = 0; i < sizeof(state); i++) *hash = (*hash ^ p[i]) * 0x100000001b3ull;
+}
+
+int replay(const char *path, int realtime)
+{
+    InputTraceReader reader;
+    Input input;
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    if (InputTraceReader_Open(&reader, path) < 0) return -1;
+    Input_Init(&input);
+    int first = InputTrace_AddDevices(&reader, &input);
+
+    double start = nowSeconds();
+    long frames = InputTrace_Replay(&reader, &input, first, realtime, hashFrame, &hash);
+    double seconds = nowSeconds() - start;
+
+    if (frames >= 0) {
+        printf("%ld frames in %.3f ms, %.1f ns per frame, state hash %016llx\n", frames, seconds * 1e3,
+               frames ? seconds * 1e9 / frames : 0, (unsigned long long) hash);
+    }
+
+    Input_Destroy(&input);
+    InputTraceReader_Close(&reader);
+
+    return frames < 0 ? -1 : 0;
+}
+
+// A virtual device that can send everything the recorded one reported
+int createUinput(const InputTraceDevice *device)
+{
+    int fd = open("/dev/uinput", O_WRONLY);
+    if (fd < 0) {
+        perror("/dev/uinput");
+        return -1;
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    for (int key = KEY_ESC; key < KEY_MAX; key++) ioctl(fd, UI_SET_KEYBIT, key);
+    if (device->capabilities & INPUT_POINTER) {
+        ioctl(fd, UI_SET_EVBIT, EV_REL);
+        ioctl(fd, UI_SET_RELBIT, REL_X);
+        ioctl(fd, UI_SET_RELBIT, REL_Y);
+        ioctl(fd, UI_SET_RELBIT, REL_WHEEL);
+    }
+    if (device->axisX[1] > device->axisX[0]) {
+        const int axes[] = { ABS_X, ABS_Y, ABS_MT_SLOT, ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y };
+        const int ranges[][2] = { { device->axisX[0], device->axisX[1] }, { device->axisY[0], device->axisY[1] },
+                                  { 0, INPUT_MAX_SLOTS - 1 }, { 0, 65535 },
+                                  { device->axisX[0], device->axisX[1] }, { device->axisY[0], device->axisY[1] } };
+        int count = device->capabilities & INPUT_TOUCH ? 6 : 2;
+
+        ioctl(fd, UI_SET_EVBIT, EV_ABS);
+        for (int i = 0; i < count; i++) {
+            struct uinput_abs_setup abs = { .code = axes[i], .absinfo = { .minimum = ranges[i][0], .maximum = ranges[i][1] } };
+            ioctl(fd, UI_SET_ABSBIT, axes[i]);
+            ioctl(fd, UI_ABS_SETUP, &abs);
+        }
+    }
+
+    struct uinput_setup setup = { .id = { .bustype = BUS_VIRTUAL, .vendor = 1, .product = 2 } };
+    snprintf(setup.name, sizeof(setup.name), "replay: %s", device->name);
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        perror("uinput device");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int replayUinput(const char *path)
+{
+    InputTraceReader reader;
+    int fds[INPUT_MAX_DEVICES];
+
+    if (InputTraceReader_Open(&reader, path) < 0) return -1;
+
+    for (uint32_t i = 0; i < reader.header.devices; i++) {
+        fds[i] = createUinput(&reader.devices[i]);
+    }
+
+    // Give readers time to find the new devices
+    sleep(1);
+    long frames = InputTrace_ReplayToFds(&reader, fds, 1);
+    printf("%ld frames replayed\n", frames);
+
+    for (uint32_t i = 0; i < reader.header.devices; i++) {
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], UI_DEV_DESTROY);
+        close(fds[i]);
+    }
+    InputTraceReader_Close(&reader);
+
+    return frames < 0 ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "record") == 0) return record(argv[2], argc > 3 ? atof(argv[3]) : 0) < 0;
+    if (argc >= 4 && strcmp(argv[1], "synth") == 0) return synth(argv[2], atof(argv[3])) < 0;
+    if (argc >= 3 && strcmp(argv[1], "info") == 0) return info(argv[2]) < 0;
+    if (argc >= 3 && strcmp(argv[1], "replay") == 0) {
+        return replay(argv[2], argc > 3 && strcmp(argv[3], "--realtime") == 0) < 0;
+    }
+    if (argc >= 3 && strcmp(argv[1], "uinput") == 0) return replayUinput(argv[2]) < 0;
+
+    fprintf(stderr, "usage: %s record FILE [SECONDS] | synth FILE SECONDS | info FILE"
+                    " | replay FILE [--realtime] | uinput FILE\n", argv[0]);
+
+    return 1;
+}
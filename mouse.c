@@ -1,32 +1,266 @@
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <linux/input.h>
+#include <linux/uinput.h>
+#include "tinyrenderer/lib/input.h"
+#include "tinyrenderer/lib/input_trace.h"
 
-int main()
+// Prints pointer and touch input, one line per frame the device reports.
+//
+//   ./mouse            every pointer and touch device, sleeps until one moves
+//   ./mouse --uinput   creates a virtual device through /dev/uinput and checks
+//                      that its events come back coalesced into frames
+//   ./mouse --bench    cost per event of the state update, no devices needed
+//   ./mouse --replay FILE [--fast]
+//                      a trace from inputtrace, paced as recorded or back to back
+
+#define UINPUT_NAME "mouse.c virtual device"
+#define BENCH_FRAMES 1000000
+
+void printFrame(const InputFrame *frame, void *user)
+{
+    printf("%llu.%06llu %-24s", (unsigned long long) (frame->timeUs / 1000000),
+           (unsigned long long) (frame->timeUs % 1000000), frame->device->name);
+
+    if (frame->changed & INPUT_CHANGED_REL) printf(" rel %d,%d", frame->dx, frame->dy);
+    if (frame->changed & INPUT_CHANGED_ABS) printf(" abs %d,%d", frame->x, frame->y);
+    if (frame->changed & INPUT_CHANGED_TOUCH) {
+        printf(" touches %d", frame->touches);
+        for (int s = 0; s < INPUT_MAX_SLOTS; s++) {
+            if (frame->slots[s].active) printf(" [%d] %d,%d", s, frame->slots[s].x, frame->slots[s].y);
+        }
+    }
+    if (frame->wheel) printf(" wheel %d", frame->wheel);
+    if (frame->changed & INPUT_CHANGED_KEYS) printf(" left %d", INPUT_BIT(frame->keys, BTN_LEFT));
+    printf(" (%d events)\n", frame->events);
+}
+
+int emit(int fd, int type, int code, int value)
+{
+    struct input_event ev = { .type = type, .code = code, .value = value };
+
+    return write(fd, &ev, sizeof(ev)) == sizeof(ev) ? 0 : -1;
+}
+
+typedef struct {
+    int frames;
+    InputFrame last;
+} Received;
+
+void keepFrame(const InputFrame *frame, void *user)
+{
+    Received *received = user;
+
+    received->frames++;
+    received->last = *frame;
+}
+
+// Creates a uinput mouse with two touch slots, sends frames of several events
+// and checks what Input makes of them
+int testUinput()
+{
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd < 0) {
+        perror("/dev/uinput");
+        return -1;
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(fd, UI_SET_KEYBIT, BTN_LEFT);
+    ioctl(fd, UI_SET_EVBIT, EV_REL);
+    ioctl(fd, UI_SET_RELBIT, REL_X);
+    ioctl(fd, UI_SET_RELBIT, REL_Y);
+    ioctl(fd, UI_SET_EVBIT, EV_ABS);
+
+    const int axes[] = { ABS_MT_SLOT, ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y };
+    const int maxima[] = { 1, 65535, 1919, 1079 };
+    for (int i = 0; i < 4; i++) {
+        struct uinput_abs_setup abs = { .code = axes[i], .absinfo = { .maximum = maxima[i] } };
+        ioctl(fd, UI_SET_ABSBIT, axes[i]);
+        ioctl(fd, UI_ABS_SETUP, &abs);
+    }
+
+    struct uinput_setup setup = { .id = { .bustype = BUS_VIRTUAL, .vendor = 1, .product = 1 } };
+    snprintf(setup.name, sizeof(setup.name), UINPUT_NAME);
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        perror("uinput device");
+        close(fd);
+        return -1;
+    }
+
+    // udev needs a moment to create the node
+    Input input;
+    int found = -1;
+    Input_Init(&input);
+    for (int attempt = 0; attempt < 50 && found < 0; attempt++) {
+        usleep(20000);
+        Input_Destroy(&input);
+        Input_Init(&input);
+        Input_OpenDevices(&input, INPUT_POINTER | INPUT_TOUCH);
+        for (int i = 0; i < input.count; i++) {
+            if (strcmp(input.devices[i].name, UINPUT_NAME) == 0) found = i;
+        }
+    }
+
+    int failures = 0;
+    if (found < 0) {
+        fprintf(stderr, "Virtual device did not show up in /dev/input\n");
+        failures++;
+    } else {
+        Received received = { 0 };
+
+        // Five motion events and a click make one frame
+        for (int i = 0; i < 5; i++) emit(fd, EV_REL, REL_X, 2);
+        emit(fd, EV_REL, REL_Y, -3);
+        emit(fd, EV_KEY, BTN_LEFT, 1);
+        emit(fd, EV_SYN, SYN_REPORT, 0);
+
+        while (received.frames < 1 && Input_Poll(&input, 1000, keepFrame, &received) > 0) {}
+        if (received.frames != 1 || received.last.dx != 10 || received.last.dy != -3
+            || !INPUT_BIT(received.last.keys, BTN_LEFT) || received.last.events != 7) {
+            fprintf(stderr, "Relative frame: %d frames, dx %d dy %d\n", received.frames, received.last.dx, received.last.dy);
+            failures++;
+        }
+
+        // Two fingers down, then the first lifts
+        received.frames = 0;
+        emit(fd, EV_ABS, ABS_MT_SLOT, 0);
+        emit(fd, EV_ABS, ABS_MT_TRACKING_ID, 10);
+        emit(fd, EV_ABS, ABS_MT_POSITION_X, 100);
+        emit(fd, EV_ABS, ABS_MT_POSITION_Y, 200);
+        emit(fd, EV_ABS, ABS_MT_SLOT, 1);
+        emit(fd, EV_ABS, ABS_MT_TRACKING_ID, 11);
+        emit(fd, EV_ABS, ABS_MT_POSITION_X, 300);
+        emit(fd, EV_ABS, ABS_MT_POSITION_Y, 400);
+        emit(fd, EV_SYN, SYN_REPORT, 0);
+        emit(fd, EV_ABS, ABS_MT_SLOT, 0);
+        emit(fd, EV_ABS, ABS_MT_TRACKING_ID, -1);
+        emit(fd, EV_SYN, SYN_REPORT, 0);
+
+        while (received.frames < 2 && Input_Poll(&input, 1000, keepFrame, &received) > 0) {}
+        InputFrame *last = &received.last;
+        if (received.frames != 2 || last->touches != 1 || last->slots[0].active || !last->slots[1].active
+            || last->slots[1].x != 300 || last->slots[1].y != 400 || last->dx != 0) {
+            fprintf(stderr, "Touch frames: %d frames, %d touches\n", received.frames, last->touches);
+            failures++;
+        }
+    }
+
+    Input_Destroy(&input);
+    ioctl(fd, UI_DEV_DESTROY);
+    close(fd);
+
+    printf("uinput: %s\n", failures ? "FAILED" : "ok");
+
+    return failures ? -1 : 0;
+}
+
+double nowSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void countFrame(const InputFrame *frame, void *user)
+{
+    *(long *) user += frame->dx;
+}
+
+// Typical touchpad traffic, a finger moving plus relative motion, fed straight into Input_Feed
+int benchFeed()
 {
-    int mouse_fd = open("/dev/input/event15", O_RDONLY | O_NONBLOCK);
-    if (mouse_fd < 0) {
-        fprintf(stderr, "Failed to open mouse handler");
+    const int perFrame = 6;
+    struct input_event *events = malloc((size_t) BENCH_FRAMES * perFrame * sizeof(struct input_event));
+    Input input;
+    long sum = 0;
+    int fds[2];
+
+    // The pipe only gives the device a slot, events go in through Input_Feed
+    if (pipe(fds) < 0 || Input_Init(&input) < 0 || Input_AddFd(&input, fds[0], "bench", INPUT_POINTER | INPUT_TOUCH) < 0) {
+        perror("bench device");
         return -1;
     }
 
-    struct input_event ev;
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        struct input_event *ev = &events[f * perFrame];
+        ev[0] = (struct input_event) { .type = EV_ABS, .code = ABS_MT_POSITION_X, .value = f % 1920 };
+        ev[1] = (struct input_event) { .type = EV_ABS, .code = ABS_MT_POSITION_Y, .value = f % 1080 };
+        ev[2] = (struct input_event) { .type = EV_ABS, .code = ABS_X, .value = f % 1920 };
+        ev[3] = (struct input_event) { .type = EV_REL, .code = REL_X, .value = 1 };
+        ev[4] = (struct input_event) { .type = EV_REL, .code = REL_Y, .value = -1 };
+        ev[5] = (struct input_event) { .type = EV_SYN, .code = SYN_REPORT };
+    }
+
+    double start = nowSeconds();
+    int frames = 0;
+    for (int f = 0; f < BENCH_FRAMES; f += INPUT_READ_EVENTS / perFrame) {
+        int n = BENCH_FRAMES - f < INPUT_READ_EVENTS / perFrame ? BENCH_FRAMES - f : INPUT_READ_EVENTS / perFrame;
+        frames += Input_Feed(&input, 0, &events[f * perFrame], n * perFrame, countFrame, &sum);
+    }
+    double seconds = nowSeconds() - start;
+
+    printf("%d frames, %d events in %.1f ms: %.2f ns per event, %.2f ns per frame\n", frames,
+           BENCH_FRAMES * perFrame, seconds * 1e3, seconds * 1e9 / (BENCH_FRAMES * perFrame), seconds * 1e9 / frames);
 
-    for(;;) {
-        if (read(mouse_fd, &ev, sizeof(ev)) == sizeof(ev)) {
-            if (ev.type == EV_ABS) {
-                printf("time:%d type: %x, code:%d, value: %d\n", ev.time, ev.type, ev.code, ev.value);
+    Input_Destroy(&input);
+    close(fds[1]);
+    free(events);
 
-                if (ev.code == ABS_X) {
-                    printf("X value: %d\n", ev.value);
-                }
+    return sum == BENCH_FRAMES ? 0 : -1;
+}
 
-                if (ev.code == ABS_MT_POSITION_X) {
-                    printf("MT X value: %d\n", ev.value);
-                }
-            }
+int replayTrace(const char *path, int fast)
+{
+    InputTraceReader reader;
+    Input input;
+
+    if (InputTraceReader_Open(&reader, path) < 0) return -1;
+    Input_Init(&input);
+
+    long frames = InputTrace_Replay(&reader, &input, InputTrace_AddDevices(&reader, &input), !fast, printFrame, NULL);
+
+    Input_Destroy(&input);
+    InputTraceReader_Close(&reader);
+
+    return frames < 0 ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--uinput") == 0) return testUinput() < 0;
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) return benchFeed() < 0;
+    if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+        return replayTrace(argv[2], argc > 3 && strcmp(argv[3], "--fast") == 0) < 0;
+    }
+
+    Input input;
+    if (Input_Init(&input) < 0 || Input_OpenDevices(&input, INPUT_POINTER | INPUT_TOUCH) == 0) {
+        fprintf(stderr, "No pointer or touch devices found in /dev/input\n");
+        return -1;
+    }
+
+    for (int i = 0; i < input.count; i++) {
+        InputDeviceInfo *info = &input.devices[i].info;
+        fprintf(stderr, "%s:%s%s x %d..%d y %d..%d\n", info->name, info->capabilities & INPUT_POINTER ? " pointer" : "",
+                info->capabilities & INPUT_TOUCH ? " touch" : "", info->axisX.min, info->axisX.max,
+                info->axisY.min, info->axisY.max);
+    }
+
+    while (Input_Open(&input) > 0) {
+        if (Input_Poll(&input, -1, printFrame, NULL) < 0) {
+            perror("epoll_wait");
+            break;
         }
-        //printf("x:%d y:%d\n", event.time);
+        fflush(stdout);
     }
-}
\ No newline at end of file
+
+    Input_Destroy(&input);
+
+    return 0;
+}
@@ -0,0 +1,266 @@
+#ifndef SNAKE_CORE_H
+#define SNAKE_CORE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// The rules of snake as a state machine with no I/O and no allocation, so
+// the console games, bots and benchmarks all play the same game.
+//
+//   SnakeCore core;
+//   SnakeCore_Init(&core, 20, 20, SNAKE_CORE_WRAP, seed);
+//   while (!core.over) SnakeCore_Step(&core, direction);
+//
+// The board is a packed grid with a byte per cell: 0 when empty, otherwise
+// a body part holding the direction to the next part towards the head. The
+// tail follows those, so moving touches three cells whatever the length.
+// Cells not under the snake are kept in a set with O(1) take and release,
+// and food is a uniform pick from it. Everything is in the struct, a copy
+// is a snapshot and a given seed always plays out the same game.
+
+#ifndef SNAKE_CORE_MAX_CELLS
+#define SNAKE_CORE_MAX_CELLS 4096           // 64 x 64, cell numbers must fit in 16 bits
+#endif
+#define SNAKE_CORE_START_LENGTH 3
+#define SNAKE_CORE_GROWTH 3                 // Segments added per food
+
+#define SNAKE_CORE_WRAP 1                   // Leaving the board comes back on the other side, otherwise it kills
+
+#define SNAKE_CORE_HEAD 5                   // Grid value of the head, parts are direction + 1
+
+typedef enum { SNAKE_UP, SNAKE_DOWN, SNAKE_LEFT, SNAKE_RIGHT } SnakeDirection;
+
+typedef enum {
+    SNAKE_MOVED,
+    SNAKE_ATE,
+    SNAKE_DIED,
+    SNAKE_WON                               // Ate the last food, the snake fills the board
+} SnakeEvent;
+
+// PCG32
+typedef struct {
+    uint64_t state;
+    uint64_t increment;
+} SnakeRng;
+
+typedef struct {
+    int width, height, flags;
+    int headX, headY, tailX, tailY;
+    int length;
+    int growth;                             // Segments still to add, the tail stays put while > 0
+    int food;                               // Cell, -1 once the board is full
+    int score;
+    int over, won;
+    uint32_t steps;
+    SnakeDirection direction;
+    SnakeRng rng;
+    int freeCount;
+    uint16_t freeCells[SNAKE_CORE_MAX_CELLS];   // freeCells[0, freeCount) are free, the rest taken
+    uint16_t freeIndex[SNAKE_CORE_MAX_CELLS];   // Position of each cell in freeCells
+    uint8_t grid[SNAKE_CORE_MAX_CELLS];
+} SnakeCore;
+
+static inline uint32_t SnakeRng_Next(SnakeRng *rng)
+{
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ull + rng->increment;
+
+    uint32_t xorshifted = (uint32_t) (((old >> 18) ^ old) >> 27);
+    uint32_t rotation = (uint32_t) (old >> 59);
+    return (xorshifted >> rotation) | (xorshifted << ((0u - rotation) & 31));
+}
+
+static inline void SnakeRng_Seed(SnakeRng *rng, uint64_t seed)
+{
+    rng->state = 0;
+    rng->increment = 1442695040888963407ull;
+    SnakeRng_Next(rng);
+    rng->state += seed;
+    SnakeRng_Next(rng);
+}
+
+// Uniform in [0, bound), Lemire's multiply and reject
+static inline uint32_t SnakeRng_Below(SnakeRng *rng, uint32_t bound)
+{
+    uint64_t product = (uint64_t) SnakeRng_Next(rng) * bound;
+
+    if ((uint32_t) product < bound) {
+        uint32_t threshold = (0u - bound) % bound;
+        while ((uint32_t) product < threshold) product = (uint64_t) SnakeRng_Next(rng) * bound;
+    }
+
+    return (uint32_t) (product >> 32);
+}
+
+static inline int SnakeCore_Opposite(SnakeDirection a, SnakeDirection b)
+{
+    // UP/DOWN and LEFT/RIGHT differ only in the low bit
+    return (a ^ b) == 1;
+}
+
+static inline int SnakeCore_Occupied(const SnakeCore *core, int x, int y)
+{
+    return core->grid[y * core->width + x] != 0;
+}
+
+// Steps x, y one cell in direction. Returns 0 when that leaves a board without wrap.
+static inline int SnakeCore_Neighbour(const SnakeCore *core, SnakeDirection direction, int *x, int *y)
+{
+    int wrap = core->flags & SNAKE_CORE_WRAP;
+
+    switch (direction) {
+        case SNAKE_UP:
+            if (*y == 0 && !wrap) return 0;
+            *y = *y == 0 ? core->height - 1 : *y - 1;
+            break;
+        case SNAKE_DOWN:
+            if (*y == core->height - 1 && !wrap) return 0;
+            *y = *y == core->height - 1 ? 0 : *y + 1;
+            break;
+        case SNAKE_LEFT:
+            if (*x == 0 && !wrap) return 0;
+            *x = *x == 0 ? core->width - 1 : *x - 1;
+            break;
+        case SNAKE_RIGHT:
+            if (*x == core->width - 1 && !wrap) return 0;
+            *x = *x == core->width - 1 ? 0 : *x + 1;
+            break;
+    }
+
+    return 1;
+}
+
+// Taking a cell swaps it with the last free one, releasing it swaps it with the first taken one
+static inline void snakeCoreSwap(SnakeCore *core, int cell, int slot)
+{
+    int other = core->freeCells[slot];
+    int from = core->freeIndex[cell];
+
+    core->freeCells[from] = (uint16_t) other;
+    core->freeIndex[other] = (uint16_t) from;
+    core->freeCells[slot] = (uint16_t) cell;
+    core->freeIndex[cell] = (uint16_t) slot;
+}
+
+static inline void snakeCoreTake(SnakeCore *core, int cell)
+{
+    snakeCoreSwap(core, cell, --core->freeCount);
+}
+
+static inline void snakeCoreRelease(SnakeCore *core, int cell)
+{
+    snakeCoreSwap(core, cell, core->freeCount++);
+}
+
+static inline void snakeCoreSpawnFood(SnakeCore *core)
+{
+    core->food = core->freeCount > 0 ? core->freeCells[SnakeRng_Below(&core->rng, core->freeCount)] : -1;
+}
+
+// Starts a game: a snake of SNAKE_CORE_START_LENGTH in the middle heading
+// right and food on a random free cell. Returns -1 when the board is too big
+// or too small for it.
+int SnakeCore_Init(SnakeCore *core, int width, int height, int flags, uint64_t seed)
+{
+    // Each side is checked first so the product cannot overflow
+    if (width < SNAKE_CORE_START_LENGTH + 1 || height < 1) return -1;
+    if (width > SNAKE_CORE_MAX_CELLS || height > SNAKE_CORE_MAX_CELLS || width * height > SNAKE_CORE_MAX_CELLS) return -1;
+
+    int cells = width * height;
+
+    core->width = width;
+    core->height = height;
+    core->flags = flags;
+    core->growth = 0;
+    core->score = 0;
+    core->over = 0;
+    core->won = 0;
+    core->steps = 0;
+    core->direction = SNAKE_RIGHT;
+    SnakeRng_Seed(&core->rng, seed);
+
+    memset(core->grid, 0, cells);
+    core->freeCount = cells;
+    for (int cell = 0; cell < cells; cell++) {
+        core->freeCells[cell] = (uint16_t) cell;
+        core->freeIndex[cell] = (uint16_t) cell;
+    }
+
+    core->tailX = (width - SNAKE_CORE_START_LENGTH) / 2;
+    core->tailY = height / 2;
+    core->headX = core->tailX + SNAKE_CORE_START_LENGTH - 1;
+    core->headY = core->tailY;
+    core->length = SNAKE_CORE_START_LENGTH;
+    for (int x = core->tailX; x <= core->headX; x++) {
+        int cell = core->tailY * width + x;
+        core->grid[cell] = x == core->headX ? SNAKE_CORE_HEAD : SNAKE_RIGHT + 1;
+        snakeCoreTake(core, cell);
+    }
+
+    snakeCoreSpawnFood(core);
+
+    return 0;
+}
+
+// Advances one step heading direction, or straight on when direction would
+// reverse into the neck. A finished game stays finished.
+SnakeEvent SnakeCore_Step(SnakeCore *core, SnakeDirection direction)
+{
+    if (core->over) return core->won ? SNAKE_WON : SNAKE_DIED;
+    if (!SnakeCore_Opposite(direction, core->direction)) core->direction = direction;
+
+    int x = core->headX, y = core->headY;
+    int width = core->width;
+
+    core->steps++;
+    if (!SnakeCore_Neighbour(core, core->direction, &x, &y)) {
+        core->over = 1;
+        return SNAKE_DIED;
+    }
+    core->grid[core->headY * width + core->headX] = (uint8_t) (core->direction + 1);
+
+    // The tail goes first, the head may take the cell it leaves
+    if (core->growth > 0) {
+        core->growth--;
+        core->length++;
+    } else {
+        int tail = core->tailY * width + core->tailX;
+        SnakeDirection next = (SnakeDirection) (core->grid[tail] - 1);
+
+        core->grid[tail] = 0;
+        snakeCoreRelease(core, tail);
+        SnakeCore_Neighbour(core, next, &core->tailX, &core->tailY);
+    }
+
+    int head = y * width + x;
+    if (core->grid[head]) {
+        core->over = 1;
+        return SNAKE_DIED;
+    }
+    core->grid[head] = SNAKE_CORE_HEAD;
+    snakeCoreTake(core, head);
+    core->headX = x;
+    core->headY = y;
+
+    if (head != core->food) return SNAKE_MOVED;
+
+    core->score++;
+    core->growth += SNAKE_CORE_GROWTH;
+    snakeCoreSpawnFood(core);
+    if (core->food < 0) {
+        core->over = 1;
+        core->won = 1;
+        return SNAKE_WON;
+    }
+
+    return SNAKE_ATE;
+}
+
+// Moves x, y from a body part to the next one towards the head. Starting at
+// tailX, tailY, length - 1 moves visit the whole snake.
+static inline void SnakeCore_NextPart(const SnakeCore *core, int *x, int *y)
+{
+    SnakeCore_Neighbour(core, (SnakeDirection) (core->grid[*y * core->width + *x] - 1), x, y);
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef SNAKE_GAME_HPP
+#define SNAKE_GAME_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "snake_core.h"
+
+// What the console snakes share, everything but the platform: the game
+// with its turn queue on top of snake_core.h, and the cell buffer it is
+// drawn into. A front-end reads keys, calls tick() on its clock and sends
+// the runs CellBuffer::flush hands it to the terminal.
+//
+// Nothing here allocates once constructed: the game state is the one
+// SnakeCore struct and the cell buffer two grids of width * height.
+
+// Two grids of characters. A frame is drawn into back, flush compares it
+// with front, what the screen already shows, and passes on only the cells
+// that changed.
+class CellBuffer {
+public:
+    CellBuffer(int width, int height)
+        : width(width), height(height), front(width * height, '\0'), back(width * height, ' ') {}
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    void clear(char c = ' ') { std::fill(back.begin(), back.end(), c); }
+
+    void put(int x, int y, char c)
+    {
+        if (x >= 0 && y >= 0 && x < width && y < height) back[y * width + x] = c;
+    }
+
+    void text(int x, int y, const char *text)
+    {
+        for (; *text; text++, x++) put(x, y, *text);
+    }
+
+    char at(int x, int y) const { return back[y * width + x]; }
+
+    // Everything is sent again on the next flush, after the screen was cleared behind our back
+    void invalidate() { std::fill(front.begin(), front.end(), '\0'); }
+
+    // Calls emit(x, y, cells, count) for each run of changed cells, row by
+    // row. Changes up to gap unchanged cells apart go out as one run, which
+    // costs less than moving the cursor over the cells in between. Returns
+    // the number of cells sent.
+    template <class Emit>
+    int flush(Emit &&emit, int gap = 4)
+    {
+        int sent = 0;
+
+        for (int y = 0; y < height; y++) {
+            const char *backRow = &back[y * width];
+            char *frontRow = &front[y * width];
+            int x = 0;
+
+            while (x < width) {
+                while (x < width && backRow[x] == frontRow[x]) x++;
+                if (x == width) break;
+
+                // Extend the run while the next change is close enough
+                int start = x, end = x + 1, unchanged = 0;
+                for (x = end; x < width && unchanged <= gap; x++) {
+                    if (backRow[x] != frontRow[x]) {
+                        end = x + 1;
+                        unchanged = 0;
+                    } else {
+                        unchanged++;
+                    }
+                }
+                x = end;
+
+                emit(start, y, backRow + start, end - start);
+                std::copy(backRow + start, backRow + end, frontRow + start);
+                sent += end - start;
+            }
+        }
+
+        return sent;
+    }
+
+private:
+    int width, height;
+    std::vector<char> front, back;
+};
+
+class SnakeGame {
+public:
+    static const int QueuedTurns = 4;
+
+    SnakeGame(int width, int height, uint64_t seed, int flags = SNAKE_CORE_WRAP)
+    {
+        if (SnakeCore_Init(&core, width, height, flags, seed) < 0) throw std::invalid_argument("board too big or too small");
+    }
+
+    // Queues a turn, so two quick presses inside one tick both happen
+    void turn(SnakeDirection direction)
+    {
+        SnakeDirection last = turnCount ? turns[turnCount - 1] : core.direction;
+
+        if (direction == last || SnakeCore_Opposite(direction, last) || turnCount == QueuedTurns) return;
+        turns[turnCount++] = direction;
+    }
+
+    // One step, taking the oldest queued turn
+    SnakeEvent tick()
+    {
+        SnakeDirection direction = core.direction;
+
+        if (turnCount > 0) {
+            direction = turns[0];
+            std::copy(turns + 1, turns + turnCount, turns);
+            turnCount--;
+        }
+
+        return SnakeCore_Step(&core, direction);
+    }
+
+    bool over() const { return core.over; }
+    bool won() const { return core.won; }
+    int score() const { return core.score; }
+    const SnakeCore &state() const { return core; }
+
+    // Draws the board into cells with its top row at top
+    void draw(CellBuffer &cells, int top) const
+    {
+        for (int y = 0; y < core.height; y++) {
+            for (int x = 0; x < core.width; x++) cells.put(x, top + y, ' ');
+        }
+
+        int x = core.tailX, y = core.tailY;
+        for (int i = 1; i < core.length; i++) {
+            cells.put(x, top + y, 'o');
+            SnakeCore_NextPart(&core, &x, &y);
+        }
+        cells.put(core.headX, top + core.headY, 'O');
+
+        if (core.food >= 0) cells.put(core.food % core.width, top + core.food / core.width, '@');
+    }
+
+private:
+    SnakeCore core;
+    SnakeDirection turns[QueuedTurns];
+    int turnCount = 0;
+};
+
+#endif
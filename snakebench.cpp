@@ -0,0 +1,232 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include "snake_game.hpp"
+
+// Checks and benchmarks for the shared snake core, runs anywhere without a
+// terminal. Exits 1 when a check fails.
+//
+//   g++ -O2 snakebench.cpp -o snakebench && ./snakebench
+
+static int failures;
+
+#define CHECK(condition, ...)                                   \
+    do {                                                        \
+        if (!(condition)) {                                     \
+            fprintf(stderr, "check failed: " __VA_ARGS__);      \
+            fprintf(stderr, "\n");                              \
+            failures++;                                         \
+        }                                                       \
+    } while (0)
+
+static volatile long benchSink;
+
+double nowSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// The free cell set, the grid and the body all agree
+static bool consistent(const SnakeCore &core)
+{
+    int cells = core.width * core.height;
+    int parts = 0;
+
+    for (int cell = 0; cell < cells; cell++) {
+        if (core.freeCells[core.freeIndex[cell]] != cell) return false;
+        if ((core.freeIndex[cell] < core.freeCount) != (core.grid[cell] == 0)) return false;
+        parts += core.grid[cell] != 0;
+    }
+    if (parts != core.length || core.freeCount != cells - core.length) return false;
+
+    int x = core.tailX, y = core.tailY;
+    for (int i = 1; i < core.length; i++) SnakeCore_NextPart(&core, &x, &y);
+
+    return x == core.headX && y == core.headY && (core.food < 0 || core.grid[core.food] == 0);
+}
+
+static void checkCore()
+{
+    SnakeRng rng;
+    long games = 0, steps = 0, eaten = 0;
+
+    SnakeRng_Seed(&rng, 1);
+    for (int flags = 0; flags <= SNAKE_CORE_WRAP; flags++) {
+        for (int seed = 0; seed < 500; seed++) {
+            SnakeGame game(7, 5, seed, flags);
+
+            while (!game.over()) {
+                // Mostly straight on, so games get long enough to fill up
+                if (SnakeRng_Below(&rng, 3) == 0) game.turn((SnakeDirection) SnakeRng_Below(&rng, 4));
+                eaten += game.tick() == SNAKE_ATE;
+                steps++;
+                if (!game.over()) CHECK(consistent(game.state()), "core state after step %u of seed %d", game.state().steps, seed);
+            }
+            games++;
+        }
+    }
+
+    // A seed plays out the same game every time
+    static SnakeCore a, b;
+    SnakeCore_Init(&a, 20, 20, SNAKE_CORE_WRAP, 42);
+    SnakeCore_Init(&b, 20, 20, SNAKE_CORE_WRAP, 42);
+    for (int i = 0; i < 1000; i++) {
+        SnakeDirection direction = (SnakeDirection) (i / 7 % 4);
+        SnakeCore_Step(&a, direction);
+        SnakeCore_Step(&b, direction);
+    }
+    CHECK(memcmp(&a, &b, sizeof(a)) == 0, "same seed, different game");
+
+    printf("core: %ld games, %ld steps, %ld foods eaten\n", games, steps, eaten);
+}
+
+static void checkTurns()
+{
+    SnakeGame game(20, 20, 1);
+    int x = game.state().headX, y = game.state().headY;
+
+    // Two presses inside one tick make two turns, reversing is ignored
+    game.turn(SNAKE_UP);
+    game.turn(SNAKE_LEFT);
+    game.turn(SNAKE_RIGHT);
+    game.tick();
+    game.tick();
+    CHECK(game.state().headX == x - 1 && game.state().headY == y - 1, "queued turns");
+    CHECK(game.state().direction == SNAKE_LEFT, "direction after queued turns");
+}
+
+static void checkCellBuffer()
+{
+    const int width = 37, height = 11;
+    CellBuffer cells(width, height);
+    std::vector<char> screen(width * height, '\0');
+    SnakeRng rng;
+
+    SnakeRng_Seed(&rng, 2);
+    for (int frame = 0; frame < 2000; frame++) {
+        int changes = SnakeRng_Below(&rng, frame % 10 == 0 ? width * height : 12);
+        for (int i = 0; i < changes; i++) {
+            cells.put(SnakeRng_Below(&rng, width), SnakeRng_Below(&rng, height), "o@ O"[SnakeRng_Below(&rng, 4)]);
+        }
+
+        int gap = frame % 6, runs = 0;
+        bool inside = true;
+        cells.flush([&](int x, int y, const char *run, int count) {
+            inside = inside && x >= 0 && count > 0 && x + count <= width && y >= 0 && y < height;
+            if (inside) memcpy(&screen[y * width + x], run, count);
+            runs++;
+        }, gap);
+
+        bool same = inside;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) same = same && screen[y * width + x] == cells.at(x, y);
+        }
+        CHECK(same, "screen differs from the cell buffer after frame %d", frame);
+
+        // Nothing changed, nothing is sent
+        CHECK(cells.flush([](int, int, const char *, int) {}) == 0, "second flush of frame %d", frame);
+    }
+
+    printf("cell buffer: 2000 frames\n");
+}
+
+// Serpentine through every cell of an even height board with wrap: right
+// along even rows, left along odd ones, down at the ends. Never dies.
+static SnakeDirection serpentine(const SnakeCore &core)
+{
+    if (core.headY % 2 == 0) return core.headX == core.width - 1 ? SNAKE_DOWN : SNAKE_RIGHT;
+    return core.headX == 0 ? SNAKE_DOWN : SNAKE_LEFT;
+}
+
+// Step cost and food spawning as the board fills, against retrying random cells
+static void benchCore()
+{
+    static SnakeCore core;
+    const int steps = 1 << 22, spawns = 1 << 20;
+    const double fills[] = { 0, 0.25, 0.5, 0.75, 0.9, 0.99 };
+
+    SnakeCore_Init(&core, 64, 64, SNAKE_CORE_WRAP, 1);
+    int cells = core.width * core.height;
+
+    printf("%10s %6s %12s %12s %12s\n", "length", "full", "ns per step", "ns spawn", "ns retrying");
+    for (double fill : fills) {
+        core.growth = (int) (fill * cells) > core.length ? (int) (fill * cells) - core.length : 0;
+        while (core.growth > 0) SnakeCore_Step(&core, serpentine(core));
+
+        // Food is eaten along the way, keep the length where it is
+        double begin = nowSeconds();
+        for (int i = 0; i < steps; i++) {
+            SnakeCore_Step(&core, serpentine(core));
+            core.growth = 0;
+        }
+        double stepSeconds = nowSeconds() - begin;
+        CHECK(!core.over, "the serpentine ran into itself at length %d", core.length);
+
+        long sum = 0;
+        begin = nowSeconds();
+        for (int i = 0; i < spawns; i++) {
+            snakeCoreSpawnFood(&core);
+            sum += core.food;
+        }
+        double spawnSeconds = nowSeconds() - begin;
+
+        begin = nowSeconds();
+        for (int i = 0; i < spawns; i++) {
+            int cell;
+            do {
+                cell = SnakeRng_Below(&core.rng, cells);
+            } while (core.grid[cell]);
+            sum -= cell;
+        }
+        double retrySeconds = nowSeconds() - begin;
+        benchSink = sum;
+
+        printf("%10d %5.1f%% %12.2f %12.2f %12.2f\n", core.length, 100.0 * core.length / cells,
+               stepSeconds * 1e9 / steps, spawnSeconds * 1e9 / spawns, retrySeconds * 1e9 / spawns);
+    }
+}
+
+// Drawing and diffing a console sized frame, the per tick cost of a front-end
+static void benchFrame()
+{
+    const int frames = 100000;
+    SnakeGame game(60, 30, 3);
+    CellBuffer cells(60, 31);
+    long sent = 0, runs = 0;
+
+    auto emit = [&](int, int, const char *, int) { runs++; };
+
+    double begin = nowSeconds();
+    for (int i = 0; i < frames; i++) {
+        if (game.over()) game = SnakeGame(60, 30, i);
+        game.turn(serpentine(game.state()));
+        game.tick();
+        game.draw(cells, 1);
+        sent += cells.flush(emit);
+    }
+    double seconds = nowSeconds() - begin;
+
+    printf("60x30 tick, draw and diff: %.0f ns per frame, %.1f cells in %.1f runs\n", seconds * 1e9 / frames,
+           (double) sent / frames, (double) runs / frames);
+}
+
+int main()
+{
+    checkCore();
+    checkTurns();
+    checkCellBuffer();
+    benchCore();
+    benchFrame();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
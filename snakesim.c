@@ -0,0 +1,306 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "snake_core.h"
+
+// Plays snake with no terminal, as many games as asked for across every
+// core, and reports games and steps per second (see snake_core.h).
+//
+//   gcc -O2 snakesim.c -o snakesim -pthread
+//   ./snakesim [--policy random|greedy|cycle] [--games N] [--threads N]
+//              [--size WxH] [--walls] [--seed N] [--max-steps N]
+//
+// Game i is seeded with seed + i, so the totals are the same for any
+// thread count and a run can be repeated exactly.
+
+#define SNAKESIM_CHUNK 256          // Games a thread takes at a time
+
+// Picks the next direction from the game state, rng is the policy's own stream
+typedef SnakeDirection (*SnakePolicy)(const SnakeCore *core, SnakeRng *rng);
+
+static int policySafe(const SnakeCore *core, SnakeDirection direction)
+{
+    int x = core->headX, y = core->headY;
+
+    if (SnakeCore_Opposite(direction, core->direction)) return 0;
+    if (!SnakeCore_Neighbour(core, direction, &x, &y)) return 0;
+
+    // The tail cell is empty by the time the head gets there, unless growing
+    return !SnakeCore_Occupied(core, x, y) || (x == core->tailX && y == core->tailY && core->growth == 0);
+}
+
+// Any direction but back, the baseline and the fastest to die
+SnakeDirection policyRandom(const SnakeCore *core, SnakeRng *rng)
+{
+    // One of three, the reverse is never drawn or stands in for RIGHT
+    SnakeDirection direction = (SnakeDirection) SnakeRng_Below(rng, 3);
+
+    return SnakeCore_Opposite(direction, core->direction) ? SNAKE_RIGHT : direction;
+}
+
+// Towards the food by the shortest way, avoiding cells that kill at once
+SnakeDirection policyGreedy(const SnakeCore *core, SnakeRng *rng)
+{
+    int foodX = core->food % core->width, foodY = core->food / core->width;
+    int dx = foodX - core->headX, dy = foodY - core->headY;
+
+    if (core->flags & SNAKE_CORE_WRAP) {
+        if (2 * dx > core->width) dx -= core->width;
+        if (2 * dx < -core->width) dx += core->width;
+        if (2 * dy > core->height) dy -= core->height;
+        if (2 * dy < -core->height) dy += core->height;
+    }
+
+    SnakeDirection wanted[2] = {
+        dx > 0 ? SNAKE_RIGHT : SNAKE_LEFT,
+        dy > 0 ? SNAKE_DOWN : SNAKE_UP
+    };
+    int first = abs(dy) > abs(dx);
+
+    if ((first ? dy : dx) != 0 && policySafe(core, wanted[first])) return wanted[first];
+    if ((first ? dx : dy) != 0 && policySafe(core, wanted[!first])) return wanted[!first];
+
+    // Blocked, take any safe direction starting from a random one
+    int start = SnakeRng_Below(rng, 4);
+    for (int i = 0; i < 4; i++) {
+        SnakeDirection direction = (SnakeDirection) ((start + i) % 4);
+        if (policySafe(core, direction)) return direction;
+    }
+
+    return core->direction;
+}
+
+// Where x, y comes along the cycle policyCycle follows
+static int cycleIndex(const SnakeCore *core, int x, int y)
+{
+    int width = core->width, height = core->height;
+
+    if (y == 0) return x;
+    if (x == 0) return width + (width - 1) * (height - 1) + height - 1 - y;
+    return width + (width - 1 - x) * (height - 1) + (x % 2 == 1 ? y - 1 : height - 1 - y);
+}
+
+// Whether every part follows the one before along the cycle. Only walked
+// before the first food, the joining below makes sure it holds by then.
+static int cycleJoined(const SnakeCore *core)
+{
+    int cells = core->width * core->height;
+    int x = core->tailX, y = core->tailY;
+    int previous = cycleIndex(core, x, y);
+
+    if (core->score > 0) return 1;
+
+    for (int i = 1; i < core->length; i++) {
+        SnakeCore_NextPart(core, &x, &y);
+        int index = cycleIndex(core, x, y);
+        if (index != (previous + 1) % cells) return 0;
+        previous = index;
+    }
+
+    return 1;
+}
+
+static int policyEats(const SnakeCore *core, SnakeDirection direction)
+{
+    int x = core->headX, y = core->headY;
+
+    return SnakeCore_Neighbour(core, direction, &x, &y) && y * core->width + x == core->food;
+}
+
+// Follows a cycle through every cell: right along row 0, then down and up
+// the columns below it from the right, and up column 0 back to row 0. Needs
+// an even width. Once the whole body lies on the cycle the head only ever
+// moves onto free cells or the tail's, so it cannot die and fills the board.
+// The starting body is not on the cycle, so until it is the snake steers
+// onto it and around the food; eating first could leave parts across its path.
+SnakeDirection policyCycle(const SnakeCore *core, SnakeRng *rng)
+{
+    int x = core->headX, y = core->headY;
+    SnakeDirection next;
+
+    (void) rng;
+    if (y == 0) next = x == core->width - 1 ? SNAKE_DOWN : SNAKE_RIGHT;
+    else if (x == 0) next = SNAKE_UP;
+    else if (x % 2 == 1) next = y == core->height - 1 ? SNAKE_LEFT : SNAKE_DOWN;
+    else next = y == 1 ? SNAKE_LEFT : SNAKE_UP;
+
+    if (cycleJoined(core)) return next;
+
+    if (policySafe(core, next) && !policyEats(core, next)) return next;
+    for (int d = 0; d < 4; d++) {
+        if (policySafe(core, (SnakeDirection) d) && !policyEats(core, (SnakeDirection) d)) return (SnakeDirection) d;
+    }
+    for (int d = 0; d < 4; d++) {
+        if (policySafe(core, (SnakeDirection) d)) return (SnakeDirection) d;
+    }
+
+    return next;
+}
+
+typedef struct {
+    const char *name;
+    SnakePolicy policy;
+} SnakePolicyEntry;
+
+static const SnakePolicyEntry policies[] = {
+    { "random", policyRandom },
+    { "greedy", policyGreedy },
+    { "cycle", policyCycle },
+};
+
+typedef struct {
+    SnakePolicy policy;
+    int width, height, flags;
+    uint64_t seed;
+    long games;
+    uint32_t maxSteps;
+    atomic_long next;           // Next game to hand out
+} Simulation;
+
+typedef struct {
+    Simulation *simulation;
+    long games, wins, timeouts;
+    long long steps, score;
+    int best;
+} Worker;
+
+void *worker(void *argument)
+{
+    Worker *w = argument;
+    Simulation *sim = w->simulation;
+    // Counted locally and stored once, the workers array packs several
+    // threads' totals into one cache line
+    Worker totals = *w;
+    SnakeCore core;
+    SnakeRng rng;
+    long first;
+
+    while ((first = atomic_fetch_add(&sim->next, SNAKESIM_CHUNK)) < sim->games) {
+        long last = first + SNAKESIM_CHUNK < sim->games ? first + SNAKESIM_CHUNK : sim->games;
+
+        for (long game = first; game < last; game++) {
+            SnakeCore_Init(&core, sim->width, sim->height, sim->flags, sim->seed + game);
+            SnakeRng_Seed(&rng, ~(sim->seed + game));
+
+            while (!core.over && core.steps < sim->maxSteps) SnakeCore_Step(&core, sim->policy(&core, &rng));
+
+            totals.games++;
+            totals.wins += core.won;
+            totals.timeouts += !core.over;
+            totals.steps += core.steps;
+            totals.score += core.score;
+            if (core.score > totals.best) totals.best = core.score;
+        }
+    }
+    *w = totals;
+
+    return NULL;
+}
+
+double nowSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [--policy random|greedy|cycle] [--games N] [--threads N] [--size WxH] [--walls] "
+                    "[--seed N] [--max-steps N]\n", program);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    Simulation sim = { .policy = policyRandom, .width = 20, .height = 20, .flags = SNAKE_CORE_WRAP, .games = 1000000 };
+    const char *policyName = "random";
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long maxSteps = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--walls") == 0) {
+            sim.flags &= ~SNAKE_CORE_WRAP;
+            continue;
+        }
+        if (!value) usage(argv[0]);
+        i++;
+
+        if (strcmp(argv[i - 1], "--policy") == 0) {
+            sim.policy = NULL;
+            for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+                if (strcmp(value, policies[p].name) == 0) sim.policy = policies[p].policy;
+            }
+            if (!sim.policy) usage(argv[0]);
+            policyName = value;
+        } else if (strcmp(argv[i - 1], "--games") == 0) {
+            sim.games = atol(value);
+        } else if (strcmp(argv[i - 1], "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(argv[i - 1], "--size") == 0) {
+            if (sscanf(value, "%dx%d", &sim.width, &sim.height) != 2) usage(argv[0]);
+        } else if (strcmp(argv[i - 1], "--seed") == 0) {
+            sim.seed = strtoull(value, NULL, 0);
+        } else if (strcmp(argv[i - 1], "--max-steps") == 0) {
+            maxSteps = atol(value);
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    SnakeCore check;
+    if (SnakeCore_Init(&check, sim.width, sim.height, sim.flags, 0) < 0) {
+        fprintf(stderr, "A board of %dx%d does not fit, boards have at most %d cells and are at least %d wide\n", sim.width, sim.height,
+                SNAKE_CORE_MAX_CELLS, SNAKE_CORE_START_LENGTH + 1);
+        return 1;
+    }
+    if (sim.policy == policyCycle && sim.width % 2 != 0) {
+        fprintf(stderr, "The cycle policy needs an even width\n");
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+
+    // Long enough for the cycle policy to fill the board, which takes about
+    // cells / SNAKE_CORE_GROWTH foods at up to cells steps each
+    long cells = (long) sim.width * sim.height;
+    sim.maxSteps = maxSteps > 0 ? maxSteps : cells * cells;
+
+    pthread_t ids[threads];
+    Worker workers[threads];
+
+    double begin = nowSeconds();
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (Worker) { .simulation = &sim };
+        pthread_create(&ids[t], NULL, worker, &workers[t]);
+    }
+
+    Worker total = { 0 };
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+        total.games += workers[t].games;
+        total.wins += workers[t].wins;
+        total.timeouts += workers[t].timeouts;
+        total.steps += workers[t].steps;
+        total.score += workers[t].score;
+        if (workers[t].best > total.best) total.best = workers[t].best;
+    }
+    double seconds = nowSeconds() - begin;
+
+    printf("%s on %dx%d%s, %d thread%s, seed %llu\n", policyName, sim.width, sim.height,
+           sim.flags & SNAKE_CORE_WRAP ? " wrapping" : " walled", threads, threads == 1 ? "" : "s",
+           (unsigned long long) sim.seed);
+    printf("%ld games, %lld steps in %.3f s\n", total.games, total.steps, seconds);
+    printf("%.0f games/s, %.0f steps/s, %.1f ns per step\n", total.games / seconds, total.steps / seconds,
+           seconds * 1e9 / total.steps);
+    printf("score mean %.2f best %d, %ld won, %ld stopped at %u steps\n", (double) total.score / total.games,
+           total.best, total.wins, total.timeouts, sim.maxSteps);
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+#define ARENA_DEBUG
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <sys/resource.h>
+#include "lib/arena.h"
+#include "lib/tga.h"
+#include "lib/wavefront_obj.h"
+#include "lib/render.h"
+
+// Runs the same transform, bin and raster frame twice: once allocating its
+// per frame storage with malloc and free like the code used to, once from a
+// frame arena. Reports time, heap allocations and page faults per frame.
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define BAND_HEIGHT 16
+#define BANDS ((HEIGHT + BAND_HEIGHT - 1) / BAND_HEIGHT)
+#define FRAMES 300
+
+typedef struct {
+    int *tris;
+    int count;
+} Bin;
+
+static int minY(ScreenTriangle *p) { int y = p->y0 < p->y1 ? p->y0 : p->y1; return y < p->y2 ? y : p->y2; }
+static int maxY(ScreenTriangle *p) { int y = p->y0 > p->y1 ? p->y0 : p->y1; return y > p->y2 ? y : p->y2; }
+
+static int clampBand(int y)
+{
+    int band = y / BAND_HEIGHT;
+
+    return band < 0 ? 0 : band >= BANDS ? BANDS - 1 : band;
+}
+
+double nowSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+double setupSeconds;            // Transform and binning, where the allocations happen
+
+// arena NULL means malloc
+void renderFrame(Mesh *mesh, TGAImage *image, float angle, Arena *arena)
+{
+    ScreenTriangle *tris;
+    Bin *bins;
+    double start = nowSeconds();
+
+    if (arena) {
+        Arena_Reset(arena);
+        tris = transformMeshRotated(mesh, WIDTH, HEIGHT, angle, arena);
+        bins = ARENA_NEW_ZERO(arena, Bin, BANDS);
+    } else {
+        Arena scratch = { malloc(mesh->trisSize * sizeof(ScreenTriangle)), mesh->trisSize * sizeof(ScreenTriangle) };
+        tris = transformMeshRotated(mesh, WIDTH, HEIGHT, angle, &scratch);
+        bins = calloc(BANDS, sizeof(Bin));
+    }
+
+    for (int i = 0; i < mesh->trisSize; i++) {
+        for (int b = clampBand(minY(&tris[i])); b <= clampBand(maxY(&tris[i])); b++) bins[b].count++;
+    }
+    for (int b = 0; b < BANDS; b++) {
+        bins[b].tris = arena ? ARENA_NEW(arena, int, bins[b].count) : malloc(bins[b].count * sizeof(int));
+        bins[b].count = 0;
+    }
+    for (int i = 0; i < mesh->trisSize; i++) {
+        for (int b = clampBand(minY(&tris[i])); b <= clampBand(maxY(&tris[i])); b++) bins[b].tris[bins[b].count++] = i;
+    }
+
+    setupSeconds += nowSeconds() - start;
+
+    for (int b = 0; b < BANDS; b++) {
+        drawScreenTriangles(tris, bins[b].tris, bins[b].count, 0, image, red);
+    }
+
+    if (!arena) {
+        start = nowSeconds();
+        for (int b = 0; b < BANDS; b++) free(bins[b].tris);
+        free(bins);
+        free(tris);
+        setupSeconds += nowSeconds() - start;
+    }
+}
+
+long minorFaults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_minflt;
+}
+
+int main()
+{
+    OBJ_Model model = { 0 };
+    Arena modelArena = Arena_Create((size_t) 1 << 30);
+    Arena frameArena = Arena_Create((size_t) 1 << 30);
+
+    OBJ_Model_init(&model);
+    if (OBJ_Model_parse("model/african_head.obj", &model) < 0) return 1;
+
+    Mesh mesh = OBJ_Model_mesh(&model, &modelArena);
+    TGAImage image = tgaCreateImage(WIDTH, HEIGHT);
+
+    printf("%-8s %12s %12s %14s %14s\n", "storage", "ms/frame", "setup us", "allocs/frame", "faults/frame");
+
+    for (int run = 0; run < 2; run++) {
+        Arena *arena = run ? &frameArena : NULL;
+
+        renderFrame(&mesh, &image, 0, arena);  // Warm up
+
+        size_t allocs = ARENA_HEAP_COUNT();
+        long faults = minorFaults();
+        double start = nowSeconds();
+
+        setupSeconds = 0;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            renderFrame(&mesh, &image, 2 * M_PI * frame / FRAMES, arena);
+        }
+
+        double seconds = nowSeconds() - start;
+
+        printf("%-8s %12.3f %12.1f %14.1f %14.1f\n", run ? "arena" : "malloc", seconds * 1e3 / FRAMES, setupSeconds * 1e6 / FRAMES,
+               (double) (ARENA_HEAP_COUNT() - allocs) / FRAMES, (double) (minorFaults() - faults) / FRAMES);
+
+        if (arena) ARENA_ASSERT_NO_HEAP(allocs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "lib/tga.h"
+#include "lib/wavefront_obj.h"
+#include "lib/render.h"
+#include "lib/arena.h"
+#include "lib/instance.h"
+#include "lib/quantized_mesh.h"
+#include "lib/band.h"
+
+// Microbenchmarks for every renderer stage plus golden image checks.
+//
+// Each benchmark runs several times and reports the median and fastest run,
+// with hardware counters per run when perf_event_open is allowed (see
+// /proc/sys/kernel/perf_event_paranoid). The golden checks render fixed
+// scenes and compare a hash of the pixels with golden.txt, a mismatching
+// image is saved as golden_<name>.tga for inspection. An optimization is
+// done when it is faster here and the golden checks still pass.
+//
+//   ./bench                  benchmarks and golden checks, exits 1 on a mismatch
+//   ./bench --update-golden  records the current images as the new golden hashes
+
+#define MAX_RUNS 15
+#define GOLDEN_PATH "golden.txt"
+#define SYNTHETIC_PATH "/tmp/tinyrenderer_synthetic.obj"
+#define SYNTHETIC_SIDE 708      // 708 x 708 quads, just over a million triangles
+
+enum { COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_CACHE_MISSES, COUNTER_BRANCH_MISSES, COUNTERS };
+
+typedef struct {
+    int fds[COUNTERS];
+    int available;
+} PerfCounters;
+
+PerfCounters perf;
+
+void Perf_Open(PerfCounters *counters)
+{
+    const uint64_t configs[COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    counters->available = 1;
+    for (int i = 0; i < COUNTERS; i++) {
+        struct perf_event_attr attr = {
+            .type = PERF_TYPE_HARDWARE,
+            .size = sizeof(attr),
+            .config = configs[i],
+            .disabled = i == 0,
+            .exclude_kernel = 1,
+            .exclude_hv = 1,
+            .read_format = PERF_FORMAT_GROUP
+        };
+
+        counters->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : counters->fds[0], 0);
+        if (counters->fds[i] < 0) {
+            for (int k = 0; k < i; k++) close(counters->fds[k]);
+            counters->available = 0;
+            return;
+        }
+    }
+}
+
+void Perf_Start(PerfCounters *counters)
+{
+    if (!counters->available) return;
+    ioctl(counters->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void Perf_Stop(PerfCounters *counters, uint64_t values[COUNTERS])
+{
+    struct { uint64_t count; uint64_t values[COUNTERS]; } group = { 0 };
+
+    if (counters->available) {
+        ioctl(counters->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        if (read(counters->fds[0], &group, sizeof(group)) != sizeof(group)) memset(&group, 0, sizeof(group));
+    }
+    memcpy(values, group.values, sizeof(group.values));
+}
+
+double nowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+typedef void (*BenchFn)(void *arg);
+
+// Runs fn runs times, items is what one run processes, for the ns per item column
+void bench(const char *name, BenchFn fn, void *arg, int runs, double items)
+{
+    double ms[MAX_RUNS];
+    uint64_t total[COUNTERS] = { 0 };
+
+    for (int run = 0; run < runs; run++) {
+        uint64_t values[COUNTERS];
+
+        Perf_Start(&perf);
+        double start = nowMs();
+        fn(arg);
+        ms[run] = nowMs() - start;
+        Perf_Stop(&perf, values);
+
+        for (int i = 0; i < COUNTERS; i++) total[i] += values[i];
+    }
+
+    qsort(ms, runs, sizeof(double), compareDoubles);
+
+    printf("%-28s %10.3f %10.3f %10.2f", name, ms[runs / 2], ms[0], ms[runs / 2] * 1e6 / items);
+    if (perf.available) {
+        printf(" %8.2f %12.0f %12.0f", total[COUNTER_CYCLES] ? (double) total[COUNTER_INSTRUCTIONS] / total[COUNTER_CYCLES] : 0,
+               (double) total[COUNTER_CACHE_MISSES] / runs, (double) total[COUNTER_BRANCH_MISSES] / runs);
+    }
+    printf("\n");
+}
+
+// The scenes benchmarked
+
+typedef struct {
+    const char *path;
+    OBJ_Model model;
+    Mesh mesh;
+    IndexedMesh indexed;
+    QuantizedMesh quantized;
+    ScreenTriangle *screen;
+    Arena arena;                // Model lifetime
+    Arena scratch;              // Reset by the benchmarks
+    TGAImage image;
+} Scene;
+
+int Scene_Load(Scene *scene, const char *path, int size)
+{
+    scene->path = path;
+    scene->arena = Arena_Create((size_t) 1 << 32);
+    scene->scratch = Arena_Create((size_t) 1 << 32);
+    OBJ_Model_init(&scene->model);
+    if (OBJ_Model_parse(path, &scene->model) < 0) return -1;
+
+    scene->mesh = OBJ_Model_mesh(&scene->model, &scene->arena);
+    scene->indexed = IndexedMesh_FromModel(&scene->model);
+    QuantizedMesh_FromModel(&scene->quantized, &scene->model, &scene->arena, 0);
+    scene->image = tgaCreateImage(size, size);
+    scene->screen = transformMeshRotated(&scene->mesh, size, size, 0, &scene->arena);
+
+    return 0;
+}
+
+void Scene_Free(Scene *scene)
+{
+    free(scene->model.vertexData);
+    free(scene->model.faceData);
+    free(scene->image.pixels);
+    Arena_Destroy(&scene->arena);
+    Arena_Destroy(&scene->scratch);
+}
+
+void benchParse(void *arg)
+{
+    Scene *scene = arg;
+    OBJ_Model model;
+
+    OBJ_Model_init(&model);
+    OBJ_Model_parse(scene->path, &model);
+    free(model.vertexData);
+    free(model.faceData);
+}
+
+void benchMesh(void *arg)
+{
+    Scene *scene = arg;
+
+    Arena_Reset(&scene->scratch);
+    OBJ_Model_mesh(&scene->model, &scene->scratch);
+}
+
+void benchProject(void *arg)
+{
+    Scene *scene = arg;
+
+    Arena_Reset(&scene->scratch);
+    transformMeshRotated(&scene->mesh, scene->image.header.width, scene->image.header.height, 0.7f, &scene->scratch);
+}
+
+void benchProjectQuantized(void *arg)
+{
+    Scene *scene = arg;
+    Mat4 rotation = Mat4_RotateY(0.7f);
+
+    Arena_Reset(&scene->scratch);
+    ScreenPoint *out = ARENA_NEW(&scene->scratch, ScreenPoint, (scene->quantized.vertexCount + 3) & ~(size_t) 3);
+    QuantizedMesh_Transform(&scene->quantized, &rotation, scene->image.header.width, scene->image.header.height, out);
+}
+
+void benchRaster(void *arg)
+{
+    Scene *scene = arg;
+
+    drawScreenTriangles(scene->screen, NULL, scene->mesh.trisSize, 0, &scene->image, red);
+}
+
+typedef struct {
+    int *coords;                // x0, y0, x1, y1 per line
+    int count;
+    TGAImage image;
+} LineSet;
+
+void benchLines(void *arg)
+{
+    LineSet *lines = arg;
+
+    for (int i = 0; i < lines->count; i++) {
+        int *c = &lines->coords[i * 4];
+        drawLine(c[0], c[1], c[2], c[3], &lines->image, white);
+    }
+}
+
+// A wavy grid of side x side quads in [-1, 1], written as OBJ text so parsing is measured too
+int writeSyntheticModel(const char *path, int side)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    for (int y = 0; y <= side; y++) {
+        for (int x = 0; x <= side; x++) {
+            float u = -1 + 2.0f * x / side, v = -1 + 2.0f * y / side;
+            fprintf(file, "v %f %f %f\n", u * 0.95f, v * 0.95f, 0.1f * sinf(8 * u) * cosf(8 * v));
+        }
+    }
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            int i = y * (side + 1) + x + 1;
+            fprintf(file, "f %d %d %d\nf %d %d %d\n", i, i + 1, i + side + 2, i, i + side + 2, i + side + 1);
+        }
+    }
+
+    return fclose(file);
+}
+
+// Golden images
+
+uint64_t imageHash(TGAImage *image)
+{
+    const uint8_t *p = (const uint8_t *) image->pixels;
+    size_t bytes = (size_t) image->header.width * image->header.height * sizeof(TGAPixel);
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    hash = (hash ^ image->header.width) * 0x100000001b3ull;
+    hash = (hash ^ image->header.height) * 0x100000001b3ull;
+    for (size_t i = 0; i < bytes; i++) {
+        hash = (hash ^ p[i]) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+#define GOLDEN_MAX 32
+
+typedef struct {
+    char names[GOLDEN_MAX][32];
+    uint64_t hashes[GOLDEN_MAX];
+    int count;
+    int update;
+    int failures;
+} Golden;
+
+void Golden_Load(Golden *golden)
+{
+    FILE *file = fopen(GOLDEN_PATH, "r");
+    if (!file) return;
+
+    while (golden->count < GOLDEN_MAX
+           && fscanf(file, "%31s %lx", golden->names[golden->count], &golden->hashes[golden->count]) == 2) {
+        golden->count++;
+    }
+
+    fclose(file);
+}
+
+// Compares image with the golden hash stored under key, reporting it as name
+void Golden_Expect(Golden *golden, const char *name, const char *key, TGAImage *image)
+{
+    uint64_t hash = imageHash(image);
+    int found = -1;
+
+    for (int i = 0; i < golden->count; i++) {
+        if (strcmp(golden->names[i], key) == 0) found = i;
+    }
+
+    if (golden->update) {
+        if (found < 0 && golden->count < GOLDEN_MAX) found = golden->count++;
+        snprintf(golden->names[found], sizeof(golden->names[found]), "%s", key);
+        golden->hashes[found] = hash;
+        printf("%-28s %016lx recorded\n", name, hash);
+        return;
+    }
+
+    if (found >= 0 && golden->hashes[found] == hash) {
+        printf("%-28s %016lx ok\n", name, hash);
+        return;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "golden_%s.tga", name);
+    tgaSaveImage(image, path);
+    printf("%-28s %016lx %s, saved %s\n", name, hash, found < 0 ? "MISSING" : "MISMATCH", path);
+    golden->failures++;
+}
+
+void Golden_Check(Golden *golden, const char *name, TGAImage *image)
+{
+    Golden_Expect(golden, name, name, image);
+}
+
+void Golden_Save(Golden *golden)
+{
+    FILE *file = fopen(GOLDEN_PATH, "w");
+    if (!file) {
+        perror(GOLDEN_PATH);
+        return;
+    }
+
+    for (int i = 0; i < golden->count; i++) {
+        fprintf(file, "%s %016lx\n", golden->names[i], golden->hashes[i]);
+    }
+
+    fclose(file);
+}
+
+void clearImage(TGAImage *image)
+{
+    memset(image->pixels, 0, (size_t) image->header.width * image->header.height * sizeof(TGAPixel));
+}
+
+void goldenScenes(Golden *golden, Scene *cube, Scene *head)
+{
+    // drawMesh is the reference every other path has to reproduce
+    TGAImage sample = tgaCreateImage(800, 800);
+    drawMesh(&cube->mesh, &sample, red);
+    Golden_Check(golden, "cube_800", &sample);
+    free(sample.pixels);
+
+    clearImage(&head->image);
+    drawMesh(&head->mesh, &head->image, red);
+    Golden_Check(golden, "head", &head->image);
+
+    clearImage(&head->image);
+    Arena_Reset(&head->scratch);
+    ScreenTriangle *tris = transformMeshRotated(&head->mesh, head->image.header.width, head->image.header.height,
+                                                0.7f, &head->scratch);
+    drawScreenTriangles(tris, NULL, head->mesh.trisSize, 0, &head->image, red);
+    Golden_Check(golden, "head_rotated", &head->image);
+
+    clearImage(&head->image);
+    Mat4 rotation = Mat4_RotateY(0.7f);
+    Arena_Reset(&head->scratch);
+    drawQuantized(&head->quantized, &rotation, &head->image, red, &head->scratch);
+    Golden_Check(golden, "head_quantized", &head->image);
+
+    // Delta coded indices decode to the same faces, so they must draw the same image
+    QuantizedMesh delta;
+    clearImage(&head->image);
+    Arena_Reset(&head->scratch);
+    if (QuantizedMesh_FromModel(&delta, &head->model, &head->scratch, QMESH_FORCE_DELTA) < 0) {
+        printf("%-28s out of memory\n", "head_quantized_delta");
+        golden->failures++;
+    } else if (!golden->update) {
+        drawQuantized(&delta, &rotation, &head->image, red, &head->scratch);
+        Golden_Expect(golden, "head_quantized_delta", "head_quantized", &head->image);
+    }
+
+    Instance instances[64];
+    for (int i = 0; i < 64; i++) {
+        instances[i].transform = Mat4_Multiply(Mat4_Translate(-0.875f + 0.25f * (i % 8), -0.875f + 0.25f * (i / 8), 0),
+                                               Mat4_Multiply(Mat4_Scale(0.1f), Mat4_RotateY(i * 0.1f)));
+        instances[i].color = (TGAPixel) { .B = i * 4, .G = 255 - i * 4, .R = 128 };
+    }
+    clearImage(&head->image);
+    Arena_Reset(&head->scratch);
+    drawInstanced(&cube->indexed, instances, 64, &head->image, 2, &head->scratch);
+    Golden_Check(golden, "cube_instanced", &head->image);
+
+    // The banded renderer must reproduce drawMesh exactly, so it is checked against the "head" hash
+    const char *bandPath = "/tmp/tinyrenderer_banded.tga";
+    if (renderBanded(&head->mesh, head->image.header.width, head->image.header.height, 64, 2, red, bandPath) == 0) {
+        FILE *file = fopen(bandPath, "rb");
+        TGAImage banded = tgaCreateImage(head->image.header.width, head->image.header.height);
+        size_t bytes = (size_t) banded.header.width * banded.header.height * sizeof(TGAPixel);
+
+        if (!file || fseek(file, sizeof(TGAHeader), SEEK_SET) != 0 || fread(banded.pixels, 1, bytes, file) != bytes) {
+            printf("%-28s unreadable\n", "head_banded");
+            golden->failures++;
+        } else if (!golden->update) {
+            Golden_Expect(golden, "head_banded", "head", &banded);
+        }
+        if (file) fclose(file);
+        free(banded.pixels);
+        unlink(bandPath);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Golden golden = { 0 };
+
+    golden.update = argc > 1 && strcmp(argv[1], "--update-golden") == 0;
+    Golden_Load(&golden);
+    Perf_Open(&perf);
+
+    if (writeSyntheticModel(SYNTHETIC_PATH, SYNTHETIC_SIDE) < 0) return 1;
+
+    Scene scenes[3];
+    const char *paths[3] = { "model/cube.obj", "model/african_head.obj", SYNTHETIC_PATH };
+    const char *names[3] = { "cube", "head", "synthetic" };
+    int sizes[3] = { 1024, 1024, 2048 };
+
+    for (int i = 0; i < 3; i++) {
+        if (Scene_Load(&scenes[i], paths[i], sizes[i]) < 0) return 1;
+    }
+
+    printf("%-28s %10s %10s %10s", "benchmark", "median ms", "min ms", "ns/item");
+    if (perf.available) printf(" %8s %12s %12s", "IPC", "cache miss", "branch miss");
+    printf("\n");
+    if (!perf.available) printf("(hardware counters unavailable, perf_event_open not permitted)\n");
+
+    for (int i = 0; i < 3; i++) {
+        Scene *scene = &scenes[i];
+        double tris = scene->mesh.trisSize;
+        int runs = i == 2 ? 5 : MAX_RUNS;
+        char name[64];
+
+        snprintf(name, sizeof(name), "parse %s", names[i]);
+        bench(name, benchParse, scene, i == 2 ? 3 : runs, tris);
+        snprintf(name, sizeof(name), "mesh %s", names[i]);
+        bench(name, benchMesh, scene, runs, tris);
+        snprintf(name, sizeof(name), "project %s", names[i]);
+        bench(name, benchProject, scene, runs, tris);
+        snprintf(name, sizeof(name), "project quantized %s", names[i]);
+        bench(name, benchProjectQuantized, scene, runs, scene->quantized.vertexCount);
+        snprintf(name, sizeof(name), "raster %s", names[i]);
+        bench(name, benchRaster, scene, runs, tris);
+    }
+
+    LineSet lines = { malloc(100000 * 4 * sizeof(int)), 100000, tgaCreateImage(1024, 1024) };
+    srand(1);
+    for (int i = 0; i < lines.count * 4; i++) lines.coords[i] = rand() % 1024;
+    bench("drawLine 100k random", benchLines, &lines, MAX_RUNS, lines.count);
+    free(lines.coords);
+    free(lines.image.pixels);
+
+    printf("\n");
+    goldenScenes(&golden, &scenes[0], &scenes[1]);
+
+    if (golden.update) Golden_Save(&golden);
+
+    for (int i = 0; i < 3; i++) Scene_Free(&scenes[i]);
+    unlink(SYNTHETIC_PATH);
+
+    if (golden.failures) printf("%d golden image check(s) failed\n", golden.failures);
+
+    return golden.failures ? 1 : 0;
+}
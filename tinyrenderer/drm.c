@@ -1,33 +1,87 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
-#include <sys/mman.h>
+#include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <drm.h>
 #include <drm_mode.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
+#include "lib/input.h"
+#include "lib/input_trace.h"
+#include "lib/latency.h"
+
+// Draws a crosshair that follows the mouse or a finger straight to the
+// display through KMS page flips, and measures input to photon latency:
+// every input frame's kernel timestamp is carried through update, render
+// and the flip, whose completion time comes with the DRM event.
+//
+//   ./drm [--buffers 2|3] [--continuous] [--frames N] [--replay TRACE]
+//
+// Frames are only drawn when input arrived, unless --continuous draws one
+// for every vblank. With 3 buffers the next frame is drawn while a flip is
+// still pending and queued behind it, which shows what a deeper queue costs.
+// --replay plays an inputtrace recording into the same epoll path in real
+// time. The latency histograms are printed on exit (Escape or Ctrl-C).
 
 #define DRM_DEVICE "/dev/dri/card1"
+#define MAX_BUFFERS 3
+
+#define COLOR_BLACK 0x00000000  // XRGB8888 format
+#define COLOR_WHITE 0x00FFFFFF
+#define COLOR_RED 0x00FF0000
 
 typedef struct {
+    uint32_t handle;
+    uint32_t fbId;
+    uint32_t pitch;
+    uint64_t size;
     uint32_t *data;
     int width;
     int height;
+    int cursorX, cursorY;       // Where the crosshair was last drawn into this buffer
+    int token;                  // Latency frame it holds
 } FrameBuffer;
 
 typedef struct {
-    uint8_t R;
-    uint8_t G;
-    uint8_t B;
-} FrameBufferPixel;
+    int fd;
+    uint32_t crtcId;
+    uint32_t connectorId;
+    drmModeModeInfo mode;
+    drmModeCrtc *originalCrtc;
+    FrameBuffer buffers[MAX_BUFFERS];
+    int bufferCount;
+    int front;                  // On screen
+    int pending;                // Flip submitted, -1 when none
+    int queued;                 // Drawn and waiting for the pending flip, -1 when none
+} Display;
+
+typedef struct {
+    int x, y;                   // Crosshair position in pixels
+    int dirty;
+    int quit;
+    LatencyTracker latency;
+    Display *display;
+} Scene;
+
+volatile sig_atomic_t stopping;
 
-void setPixel(FrameBuffer *buffer, int x, int y, FrameBufferPixel color)
+void stop(int signal)
 {
-    buffer->data[width * y + x] = (color.R << 16) | (color.G << 8) | color.B;
+    stopping = 1;
 }
 
-void drawLine(int x0, int y0, int x1, int y1, uint32_t *fb_data, int width, TGAPixel color)
+void setPixel(FrameBuffer *buffer, int x, int y, uint32_t color)
+{
+    if (x < 0 || y < 0 || x >= buffer->width || y >= buffer->height) return;
+    buffer->data[(buffer->pitch / 4) * y + x] = color;
+}
+
+void drawLine(FrameBuffer *buffer, int x0, int y0, int x1, int y1, uint32_t color)
 {
     // https://zingl.github.io/bresenham.html
     int dx = abs(x1 - x0);
@@ -37,8 +91,7 @@ void drawLine(int x0, int y0, int x1, int y1, uint32_t *fb_data, int width, TGAP
     int err = dx + dy;  // error value
 
     for (;;) {
-        
-        fb_data[width*y0 + x0] = (color.R << 16) | (color.G << 8) | color.B;
+        setPixel(buffer, x0, y0, color);
 
         if (x0 == x1 && y0 == y1) break;
         int e2 = 2 * err;
@@ -47,149 +100,372 @@ void drawLine(int x0, int y0, int x1, int y1, uint32_t *fb_data, int width, TGAP
     }
 }
 
-int main() {
-    int fd;
+void drawCrosshair(FrameBuffer *buffer, int x, int y, uint32_t color, uint32_t center)
+{
+    drawLine(buffer, 0, y, buffer->width - 1, y, color);
+    drawLine(buffer, x, 0, x, buffer->height - 1, color);
+    for (int i = -4; i <= 4; i++) drawLine(buffer, x - 4, y + i, x + 4, y + i, center);
+}
+
+int createBuffer(int fd, int width, int height, FrameBuffer *buffer)
+{
+    struct drm_mode_create_dumb create_dumb = { .width = width, .height = height, .bpp = 32 };
+    struct drm_mode_map_dumb map_dumb = { 0 };
+
+    memset(buffer, 0, sizeof(*buffer));
+    if (drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &create_dumb) < 0) {
+        perror("Failed to create dumb buffer");
+        return -1;
+    }
+    buffer->handle = create_dumb.handle;
+    buffer->pitch = create_dumb.pitch;
+    buffer->size = create_dumb.size;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->token = -1;
+
+    if (drmModeAddFB(fd, width, height, 24, 32, buffer->pitch, buffer->handle, &buffer->fbId) < 0) {
+        perror("Failed to add framebuffer");
+        return -1;
+    }
+
+    map_dumb.handle = buffer->handle;
+    if (drmIoctl(fd, DRM_IOCTL_MODE_MAP_DUMB, &map_dumb) < 0) {
+        perror("Failed to map dumb buffer");
+        return -1;
+    }
+    buffer->data = mmap(0, buffer->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, map_dumb.offset);
+    if (buffer->data == MAP_FAILED) {
+        buffer->data = NULL;
+        perror("Failed to mmap framebuffer");
+        return -1;
+    }
+
+    // Dumb buffers start zeroed, so black, and the first frame erases a crosshair nobody drew
+    buffer->cursorX = buffer->cursorY = -1;
+
+    return 0;
+}
+
+void destroyBuffer(int fd, FrameBuffer *buffer)
+{
+    if (buffer->data) munmap(buffer->data, buffer->size);
+    if (buffer->fbId) drmModeRmFB(fd, buffer->fbId);
+    if (buffer->handle) {
+        struct drm_mode_destroy_dumb destroy_dumb = { .handle = buffer->handle };
+        drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy_dumb);
+    }
+}
+
+int openDisplay(Display *display, int bufferCount)
+{
     drmModeRes *res;
     drmModeConnector *connector = NULL;
     drmModeEncoder *encoder = NULL;
-    drmModeCrtc *original_crtc = NULL;
-    uint32_t fb_id = 0;
-    struct drm_mode_create_dumb create_dumb = {0};
-    struct drm_mode_map_dumb map_dumb = {0};
-    void *fb_data = NULL;
-
- // 1. Open DRM device
-    fd = open(DRM_DEVICE, O_RDWR);
-    if (fd < 0) {
+    uint64_t monotonic = 0;
+
+    memset(display, 0, sizeof(*display));
+    display->pending = display->queued = -1;
+    display->bufferCount = bufferCount;
+
+    // 1. Open DRM device
+    display->fd = open(DRM_DEVICE, O_RDWR | O_CLOEXEC);
+    if (display->fd < 0) {
         perror("Failed to open DRM device");
-        return 1;
+        return -1;
+    }
+
+    // Flip timestamps have to be on the clock evdev uses
+    if (drmGetCap(display->fd, DRM_CAP_TIMESTAMP_MONOTONIC, &monotonic) < 0 || !monotonic) {
+        fprintf(stderr, "Flip timestamps are not CLOCK_MONOTONIC, latencies will be wrong\n");
     }
 
     // 2. Get DRM resources
-    res = drmModeGetResources(fd);
+    res = drmModeGetResources(display->fd);
     if (!res) {
         perror("Failed to get DRM resources");
-        close(fd);
-        return 1;
+        return -1;
     }
 
     // 3. Find first connected connector
     for (int i = 0; i < res->count_connectors; i++) {
-        connector = drmModeGetConnector(fd, res->connectors[i]);
-        if (connector->connection == DRM_MODE_CONNECTED) {
+        connector = drmModeGetConnector(display->fd, res->connectors[i]);
+        if (!connector) continue;
+        if (connector->connection == DRM_MODE_CONNECTED && connector->count_modes > 0) {
             break;
         }
         drmModeFreeConnector(connector);
         connector = NULL;
     }
+    drmModeFreeResources(res);
     if (!connector) {
         fprintf(stderr, "No connected connectors found\n");
-        drmModeFreeResources(res);
-        close(fd);
-        return 1;
+        return -1;
     }
 
     // 4. Get encoder and original CRTC
-    encoder = drmModeGetEncoder(fd, connector->encoder_id);
+    encoder = drmModeGetEncoder(display->fd, connector->encoder_id);
     if (!encoder || !encoder->crtc_id) {
         fprintf(stderr, "Failed to get encoder or CRTC\n");
-        goto cleanup;
+        if (encoder) drmModeFreeEncoder(encoder);
+        drmModeFreeConnector(connector);
+        return -1;
     }
 
-    original_crtc = drmModeGetCrtc(fd, encoder->crtc_id);
-    if (!original_crtc) {
-        perror("Failed to get original CRTC");
-        goto cleanup;
+    display->crtcId = encoder->crtc_id;
+    display->connectorId = connector->connector_id;
+    display->mode = connector->modes[0];
+    display->originalCrtc = drmModeGetCrtc(display->fd, encoder->crtc_id);
+    drmModeFreeEncoder(encoder);
+    drmModeFreeConnector(connector);
+
+    // 5. Create the buffers
+    for (int i = 0; i < bufferCount; i++) {
+        if (createBuffer(display->fd, display->mode.hdisplay, display->mode.vdisplay, &display->buffers[i]) < 0) {
+            return -1;
+        }
     }
 
-    // 5. Create dumb buffer
-    create_dumb.width = connector->modes[0].hdisplay;
-    create_dumb.height = connector->modes[0].vdisplay;
-    create_dumb.bpp = 32;
-    if (drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &create_dumb) < 0) {
-        perror("Failed to create dumb buffer");
-        goto cleanup;
+    // 6. Show the first one
+    if (drmModeSetCrtc(display->fd, display->crtcId, display->buffers[0].fbId, 0, 0,
+                       &display->connectorId, 1, &display->mode) < 0) {
+        perror("Failed to set CRTC");
+        return -1;
     }
 
-    // 6. Create framebuffer
-    if (drmModeAddFB(fd, create_dumb.width, create_dumb.height, 
-                    24, 32, create_dumb.pitch, create_dumb.handle, &fb_id) < 0) {
-        perror("Failed to add framebuffer");
-        goto cleanup;
+    return 0;
+}
+
+void closeDisplay(Display *display)
+{
+    // Restore original CRTC state
+    if (display->originalCrtc) {
+        drmModeSetCrtc(display->fd, display->originalCrtc->crtc_id, display->originalCrtc->buffer_id,
+                       display->originalCrtc->x, display->originalCrtc->y,
+                       &display->connectorId, 1, &display->originalCrtc->mode);
+        drmModeFreeCrtc(display->originalCrtc);
     }
 
-    // 7. Map framebuffer
-    map_dumb.handle = create_dumb.handle;
-    if (drmIoctl(fd, DRM_IOCTL_MODE_MAP_DUMB, &map_dumb) < 0) {
-        perror("Failed to map dumb buffer");
-        goto cleanup;
+    for (int i = 0; i < display->bufferCount; i++) destroyBuffer(display->fd, &display->buffers[i]);
+    if (display->fd >= 0) close(display->fd);
+}
+
+// A buffer that is neither on screen, nor being flipped to, nor queued
+int freeBuffer(Display *display)
+{
+    for (int i = 0; i < display->bufferCount; i++) {
+        if (i != display->front && i != display->pending && i != display->queued) return i;
     }
-    fb_data = mmap(0, create_dumb.size, PROT_WRITE, 
-                  MAP_SHARED, fd, map_dumb.offset);
-    if (fb_data == MAP_FAILED) {
-        perror("Failed to mmap framebuffer");
-        goto cleanup;
+
+    return -1;
+}
+
+void submitFlip(Display *display, int buffer)
+{
+    if (drmModePageFlip(display->fd, display->crtcId, display->buffers[buffer].fbId,
+                        DRM_MODE_PAGE_FLIP_EVENT, display) < 0) {
+        perror("Failed to queue page flip");
+        return;
     }
+    display->pending = buffer;
+}
 
-    // 8. Draw pattern (simple gradient)
-    // for (int y = 0; y < create_dumb.height; y++) {
-    //     for (int x = 0; x < create_dumb.width; x++) {
-    //         uint8_t r = x * 255 / create_dumb.width;
-    //         uint8_t g = y * 255 / create_dumb.height;
-    //        // fb_data[y * create_dumb.width + x] = (r << 16) | (g << 8) | 0xFF;
-    //     }
-    // }
+Scene *flipScene;
 
-    // 9. Set new CRTC
-    if (drmModeSetCrtc(fd, original_crtc->crtc_id, fb_id, 
-                      0, 0, &connector->connector_id, 1, &connector->modes[0]) < 0) {
-        perror("Failed to set CRTC");
-        goto cleanup;
-    }
-    
-    #define COLOR_WHITE 0x00FFFFFF  // XRGB8888 format
-
-    for (int x = 0; x < create_dumb.width; x += 10) {
-    // Draw vertical line
-    for (int y = 0; y < create_dumb.height; y++) {
-        uint32_t *row = (uint32_t*)((char*)fb_data + y * create_dumb.pitch);
-        for (int dx = 0; dx < 10; dx++) {
-            if (x + dx < create_dumb.width) {
-                row[x + dx] = COLOR_WHITE;
+void pageFlipped(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec, void *user_data)
+{
+    Display *display = user_data;
+    FrameBuffer *shown = &display->buffers[display->pending];
+
+    Latency_Presented(&flipScene->latency, shown->token, (uint64_t) tv_sec * 1000000 + tv_usec);
+    shown->token = -1;
+    display->front = display->pending;
+    display->pending = -1;
+
+    if (display->queued >= 0) {
+        submitFlip(display, display->queued);
+        display->queued = -1;
+    }
+}
+
+void handleInput(const InputFrame *frame, void *user)
+{
+    Scene *scene = user;
+    FrameBuffer *buffer = &scene->display->buffers[0];
+    const InputDeviceInfo *device = frame->device;
+
+    Latency_Input(&scene->latency, frame->timeUs);
+
+    if (frame->changed & INPUT_CHANGED_REL) {
+        scene->x += frame->dx;
+        scene->y += frame->dy;
+    }
+
+    // Absolute devices and touch map their whole range onto the screen
+    int touched = (frame->changed & INPUT_CHANGED_TOUCH) && frame->slots[0].active;
+    if ((touched || (frame->changed & INPUT_CHANGED_ABS)) && device->axisX.max > device->axisX.min) {
+        int x = touched ? frame->slots[0].x : frame->x;
+        int y = touched ? frame->slots[0].y : frame->y;
+
+        scene->x = (long) (x - device->axisX.min) * (buffer->width - 1) / (device->axisX.max - device->axisX.min);
+        scene->y = (long) (y - device->axisY.min) * (buffer->height - 1) / (device->axisY.max - device->axisY.min);
+    }
+
+    if (scene->x < 0) scene->x = 0;
+    if (scene->y < 0) scene->y = 0;
+    if (scene->x >= buffer->width) scene->x = buffer->width - 1;
+    if (scene->y >= buffer->height) scene->y = buffer->height - 1;
+
+    if ((frame->changed & INPUT_CHANGED_KEYS) && INPUT_BIT(frame->keys, KEY_ESC)) scene->quit = 1;
+    scene->dirty = 1;
+}
+
+void drawFrame(Scene *scene, int index)
+{
+    Display *display = scene->display;
+    FrameBuffer *buffer = &display->buffers[index];
+
+    // Update: the input handlers already moved the crosshair, take the frame's snapshot of it
+    int token = Latency_BeginFrame(&scene->latency);
+    int x = scene->x, y = scene->y;
+    scene->dirty = 0;
+    Latency_Mark(&scene->latency, token, LATENCY_UPDATE);
+
+    // Render: erase where this buffer last had the crosshair, draw it at the new place
+    if (buffer->cursorX >= 0) drawCrosshair(buffer, buffer->cursorX, buffer->cursorY, COLOR_BLACK, COLOR_BLACK);
+    drawCrosshair(buffer, x, y, COLOR_WHITE, COLOR_RED);
+    buffer->cursorX = x;
+    buffer->cursorY = y;
+    buffer->token = token;
+    Latency_Mark(&scene->latency, token, LATENCY_RENDER);
+
+    if (display->pending < 0) submitFlip(display, index);
+    else display->queued = index;
+}
+
+typedef struct {
+    InputTraceReader reader;
+    int fds[INPUT_MAX_DEVICES];
+} Replay;
+
+void closeReplayFds(void *arg)
+{
+    Replay *replay = arg;
+
+    for (uint32_t i = 0; i < replay->reader.header.devices; i++) close(replay->fds[i]);
+}
+
+// Closing the pipes when done, or when cancelled, is what tells the main loop the trace ended
+void* replayThread(void *arg)
+{
+    Replay *replay = arg;
+
+    pthread_cleanup_push(closeReplayFds, replay);
+    InputTrace_ReplayToFds(&replay->reader, replay->fds, 1);
+    pthread_cleanup_pop(1);
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int bufferCount = 2, continuous = 0;
+    long frames = 0;
+    const char *tracePath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--buffers") == 0 && i + 1 < argc) bufferCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--continuous") == 0) continuous = 1;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = atol(argv[++i]);
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) tracePath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--buffers 2|3] [--continuous] [--frames N] [--replay TRACE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (bufferCount < 2) bufferCount = 2;
+    if (bufferCount > MAX_BUFFERS) bufferCount = MAX_BUFFERS;
+
+    Input input;
+    Replay replay;
+    pthread_t replayer;
+
+    Input_Init(&input);
+    if (tracePath) {
+        // Each recorded device gets a pipe, so the replay goes through epoll and read like live input
+        if (InputTraceReader_Open(&replay.reader, tracePath) < 0) return 1;
+        for (uint32_t i = 0; i < replay.reader.header.devices; i++) {
+            InputTraceDevice *recorded = &replay.reader.devices[i];
+            int p[2];
+
+            if (pipe(p) < 0) return 1;
+            replay.fds[i] = p[1];
+            int index = Input_AddFd(&input, p[0], recorded->name, recorded->capabilities);
+            if (index < 0) {
+                fprintf(stderr, "Failed to add input device %s\n", recorded->name);
+                close(p[0]);
+                close(p[1]);
+                Input_Destroy(&input);
+                return 1;
             }
+            input.devices[index].info.axisX = (InputAxis) { recorded->axisX[0], recorded->axisX[1] };
+            input.devices[index].info.axisY = (InputAxis) { recorded->axisY[0], recorded->axisY[1] };
         }
+    } else if (Input_OpenDevices(&input, INPUT_POINTER | INPUT_TOUCH | INPUT_KEYBOARD) == 0) {
+        fprintf(stderr, "No input devices found in /dev/input\n");
+        return 1;
     }
 
-    // Flush and notify
-    // msync(fb_data, create_dumb.size, MS_SYNC);
-    // drmModeClip clip = {.x1 = x, .y1 = 0, .x2 = x+10, .y2 = create_dumb.height};
-    // drmModeDirtyFB(fd, fb_id, &clip, 1);
-    drmModeDirtyFB(fd, fb_id, NULL, 0);
+    Display display;
+    Scene scene = { .display = &display };
+    Latency_Init(&scene.latency);
+    flipScene = &scene;
 
-    sleep(1);
-}
+    if (openDisplay(&display, bufferCount) < 0) {
+        closeDisplay(&display);
+        Input_Destroy(&input);
+        return 1;
+    }
+    scene.x = display.mode.hdisplay / 2;
+    scene.y = display.mode.vdisplay / 2;
+    scene.dirty = 1;
 
-    // Wait for user input before exiting
-    printf("Press Enter to exit...\n");
-    //getchar();
+    if (tracePath) pthread_create(&replayer, NULL, replayThread, &replay);
+    signal(SIGINT, stop);
+    signal(SIGPIPE, SIG_IGN);
 
-cleanup:
-    // 10. Restore original CRTC state
-    if (original_crtc) {
-        drmModeSetCrtc(fd, original_crtc->crtc_id, original_crtc->buffer_id,
-                      original_crtc->x, original_crtc->y,
-                      &connector->connector_id, 1, &original_crtc->mode);
-        drmModeFreeCrtc(original_crtc);
+    drmEventContext events = { .version = 2, .page_flip_handler = pageFlipped };
+    struct pollfd fds[2] = {
+        { .fd = input.epoll, .events = POLLIN },
+        { .fd = display.fd, .events = POLLIN }
+    };
+
+    while (!stopping && !scene.quit && (!frames || scene.latency.frameCount < (uint64_t) frames)) {
+        // Draw whenever there is something new and a buffer to draw into
+        int index = freeBuffer(&display);
+        if ((scene.dirty || continuous) && index >= 0 && display.queued < 0) drawFrame(&scene, index);
+
+        // A finished replay ends the run once the last frame is on screen
+        if (Input_Open(&input) == 0 && display.pending < 0 && !scene.dirty) break;
+
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[0].revents & POLLIN) Input_Poll(&input, 0, handleInput, &scene);
+        if (fds[1].revents & POLLIN) drmHandleEvent(display.fd, &events);
     }
 
-    // Cleanup resources
-    if (fb_data) munmap(fb_data, create_dumb.size);
-    if (fb_id) drmModeRmFB(fd, fb_id);
-    struct drm_mode_destroy_dumb destroy_dumb = {.handle = create_dumb.handle};
-    drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy_dumb);
-    if (encoder) drmModeFreeEncoder(encoder);
-    if (connector) drmModeFreeConnector(connector);
-    if (res) drmModeFreeResources(res);
-    close(fd);
+    // Let the last flip land before taking the buffers away
+    while (display.pending >= 0 && poll(&fds[1], 1, 100) > 0) drmHandleEvent(display.fd, &events);
+
+    closeDisplay(&display);
+    if (tracePath) {
+        pthread_cancel(replayer);
+        pthread_join(replayer, NULL);
+        InputTraceReader_Close(&replay.reader);
+    }
+    Input_Destroy(&input);
+
+    printf("%d buffers%s\n", bufferCount, continuous ? ", continuous" : "");
+    Latency_Print(&scene.latency, stdout);
+
     return 0;
 }
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include "lib/tga.h"
+#include "lib/wavefront_obj.h"
+#include "lib/render.h"
+#include "lib/arena.h"
+#include "lib/instance.h"
+
+// Draws a grid of 10000 cubes and one of 100 heads with drawInstanced, part
+// of each grid off screen so culling has work to do. Saves the results as
+// instanced_cubes.tga and instanced_heads.tga.
+
+#define SIZE 2048
+#define RUNS 5
+
+double nowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+// side x side instances spread a little wider than the screen
+Instance* makeGrid(int side, float scale)
+{
+    Instance *instances = malloc(side * side * sizeof(Instance));
+
+    srand(1);
+    for (int i = 0; i < side * side; i++) {
+        float x = -1.1f + 2.2f * (i % side + 0.5f) / side;
+        float y = -1.1f + 2.2f * (i / side + 0.5f) / side;
+        Mat4 rotation = Mat4_Multiply(Mat4_RotateY(rand() % 628 / 100.0f), Mat4_RotateX(rand() % 628 / 100.0f));
+
+        instances[i].transform = Mat4_Multiply(Mat4_Translate(x, y, 0), Mat4_Multiply(Mat4_Scale(scale), rotation));
+        instances[i].color = (TGAPixel) { .B = 64 + rand() % 192, .G = 64 + rand() % 192, .R = 64 + rand() % 192 };
+    }
+
+    return instances;
+}
+
+void bench(const char *name, const char *path, const char *output, int side, float scale, int threads)
+{
+    OBJ_Model model = { 0 };
+
+    OBJ_Model_init(&model);
+    if (OBJ_Model_parse(path, &model) < 0) return;
+
+    IndexedMesh mesh = IndexedMesh_FromModel(&model);
+    Instance *instances = makeGrid(side, scale);
+    int count = side * side;
+    TGAImage image = tgaCreateImage(SIZE, SIZE);
+    Arena arena = Arena_Create((size_t) 1 << 30);
+    double best = 1e9;
+    int drawn = 0;
+
+    for (int run = 0; run < RUNS; run++) {
+        memset(image.pixels, 0, (size_t) SIZE * SIZE * sizeof(TGAPixel));
+
+        double start = nowMs();
+        drawn = drawInstanced(&mesh, instances, count, &image, threads, &arena);
+        double ms = nowMs() - start;
+
+        if (ms < best) best = ms;
+    }
+
+    size_t meshBytes = mesh.vertexCount * sizeof(Vertex3D) + mesh.faceCount * sizeof(Face32);
+    size_t copyBytes = (size_t) count * mesh.faceCount * sizeof(Triangle);
+
+    printf("%-6s %6d instances %6d drawn %8.2f ms  %3d threads  mesh %zu KiB + instances %zu KiB"
+           " (a Mesh per copy: %zu KiB)\n", name, count, drawn, best, threads, meshBytes / 1024,
+           count * sizeof(Instance) / 1024, copyBytes / 1024);
+
+    tgaSaveImage(&image, output);
+
+    Arena_Destroy(&arena);
+    free(image.pixels);
+    free(instances);
+    free(model.vertexData);
+    free(model.faceData);
+}
+
+int main()
+{
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    bench("cube", "model/cube.obj", "instanced_cubes.tga", 100, 0.008f, 1);
+    if (threads > 1) bench("cube", "model/cube.obj", "instanced_cubes.tga", 100, 0.008f, threads);
+    bench("head", "model/african_head.obj", "instanced_heads.tga", 10, 0.09f, 1);
+    if (threads > 1) bench("head", "model/african_head.obj", "instanced_heads.tga", 10, 0.09f, threads);
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "profile.h"
+
+// Allocation without the heap for the render loop.
+//
+// An Arena is a bump allocator over one reserved range of address space.
+// Everything a frame needs is carved out of it and Arena_Reset drops it all
+// at once. Pages are only faulted in the first time the arena grows that far,
+// so once the loop has seen its largest frame it never faults again.
+//
+// Building with -DARENA_DEBUG counts every malloc, calloc, realloc and
+// aligned_alloc in the process, ARENA_ASSERT_NO_HEAP checks that a stretch
+// of code made none.
+
+#define ARENA_ALIGN 16
+
+typedef struct {
+    uint8_t *base;
+    size_t reserved;
+    size_t used;
+    size_t peak;                // Highest used so far, the part of the range that is faulted in
+} Arena;
+
+// Reserves size bytes of address space, nothing is committed until used
+Arena Arena_Create(size_t size)
+{
+    Arena arena = { 0 };
+
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        perror("Failed to reserve arena");
+        return arena;
+    }
+
+    arena.base = base;
+    arena.reserved = size;
+
+    return arena;
+}
+
+void Arena_Destroy(Arena *arena)
+{
+    if (arena->base) munmap(arena->base, arena->reserved);
+    arena->base = NULL;
+}
+
+// Returns size bytes aligned to align, a power of two, or NULL when the arena is full
+void* Arena_Alloc(Arena *arena, size_t size, size_t align)
+{
+    size_t start = (arena->used + align - 1) & ~(align - 1);
+
+    if (start + size > arena->reserved) {
+        fprintf(stderr, "Arena of %zu bytes exhausted\n", arena->reserved);
+        return NULL;
+    }
+
+    arena->used = start + size;
+    PROFILE_COUNT(PROFILE_ALLOCATIONS, 1);
+    if (arena->used > arena->peak) arena->peak = arena->used;
+
+    return arena->base + start;
+}
+
+void* Arena_AllocZero(Arena *arena, size_t size, size_t align)
+{
+    void *p = Arena_Alloc(arena, size, align);
+    if (p) memset(p, 0, size);
+
+    return p;
+}
+
+// Frees everything allocated since mark, Arena_Reset frees everything
+static inline size_t Arena_Mark(Arena *arena) { return arena->used; }
+static inline void Arena_Release(Arena *arena, size_t mark) { arena->used = mark; }
+static inline void Arena_Reset(Arena *arena) { arena->used = 0; }
+
+#define ARENA_NEW(arena, type, count) \
+    ((type *) Arena_Alloc((arena), sizeof(type) * (count), _Alignof(type) > ARENA_ALIGN ? _Alignof(type) : ARENA_ALIGN))
+
+#define ARENA_NEW_ZERO(arena, type, count) \
+    ((type *) Arena_AllocZero((arena), sizeof(type) * (count), _Alignof(type) > ARENA_ALIGN ? _Alignof(type) : ARENA_ALIGN))
+
+#ifdef ARENA_DEBUG
+#include <assert.h>
+
+// Interposes the glibc allocator, every heap allocation in the process goes through here
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+
+volatile size_t arenaHeapAllocations;
+
+void* malloc(size_t size) { __atomic_add_fetch(&arenaHeapAllocations, 1, __ATOMIC_RELAXED); return __libc_malloc(size); }
+void* calloc(size_t count, size_t size) { __atomic_add_fetch(&arenaHeapAllocations, 1, __ATOMIC_RELAXED); return __libc_calloc(count, size); }
+void* realloc(void *p, size_t size) { __atomic_add_fetch(&arenaHeapAllocations, 1, __ATOMIC_RELAXED); return __libc_realloc(p, size); }
+void* aligned_alloc(size_t align, size_t size) { __atomic_add_fetch(&arenaHeapAllocations, 1, __ATOMIC_RELAXED); return __libc_memalign(align, size); }
+
+#define ARENA_HEAP_COUNT() (arenaHeapAllocations)
+#define ARENA_ASSERT_NO_HEAP(since) assert(arenaHeapAllocations == (since))
+#else
+#define ARENA_HEAP_COUNT() ((size_t) 0)
+#define ARENA_ASSERT_NO_HEAP(since) ((void) (since))
+#endif
+
+#endif
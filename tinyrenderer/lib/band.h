@@ -0,0 +1,249 @@
+#ifndef BAND_H
+#define BAND_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "tga.h"
+#include "wavefront_obj.h"
+#include "render.h"
+#include "arena.h"
+#include "profile.h"
+
+// Banded rendering for images far larger than memory wants to hold. The
+// triangles are projected and binned by horizontal band once, then every
+// band is drawn into a small reusable buffer and streamed to the file.
+// Memory is bounded by the band buffers, not the image. Worker threads
+// draw bands in parallel while the calling thread writes them in order.
+//
+// TGA stores width and height as 16 bit values, so 65535 is the limit per side.
+
+#define BAND_ARENA_RESERVE ((size_t) 1 << 32)  // Address space for the bins
+
+typedef struct {
+    ScreenTriangle *tris;
+    size_t trisSize;
+    int *binStart;              // Triangles of band b are binTris[binStart[b] .. binStart[b + 1]]
+    int *binTris;
+    int bandCount;
+    int bandHeight;
+    int width;
+    int height;
+
+    // Band buffers cycle through bufferCount slots, band b uses slot b % bufferCount
+    TGAImage *buffers;
+    int bufferCount;
+    int *slotBand;              // Band drawn into each slot
+    int *slotDone;
+    int nextBand;               // Next band a worker picks up
+    int written;                // Bands already written to the file
+    TGAPixel color;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} BandRenderer;
+
+static inline int bandMin3(int a, int b, int c) { return a < b ? (a < c ? a : c) : (b < c ? b : c); }
+static inline int bandMax3(int a, int b, int c) { return a > b ? (a > c ? a : c) : (b > c ? b : c); }
+
+// Projects every triangle once and sorts them into bands with a counting sort
+int BandRenderer_Bin(BandRenderer *renderer, Mesh *mesh, Arena *arena)
+{
+    renderer->trisSize = mesh->trisSize;
+    renderer->tris = transformMeshRotated(mesh, renderer->width, renderer->height, 0, arena);
+    renderer->binStart = ARENA_NEW_ZERO(arena, int, renderer->bandCount + 1);
+    if (!renderer->tris || !renderer->binStart) return -1;
+
+    PROFILE_SCOPE("bin");
+
+    // Two passes over the same band ranges: count, then place
+    for (int pass = 0; pass < 2; pass++) {
+        int *cursor = NULL;
+
+        if (pass == 1) {
+            for (int b = 0; b < renderer->bandCount; b++) {
+                renderer->binStart[b + 1] += renderer->binStart[b];
+            }
+            renderer->binTris = ARENA_NEW(arena, int, renderer->binStart[renderer->bandCount] + 1);
+            cursor = ARENA_NEW(arena, int, renderer->bandCount);
+            if (!renderer->binTris || !cursor) return -1;
+            memcpy(cursor, renderer->binStart, renderer->bandCount * sizeof(int));
+        }
+
+        for (size_t i = 0; i < renderer->trisSize; i++) {
+            ScreenTriangle *p = &renderer->tris[i];
+            int first = bandMin3(p->y0, p->y1, p->y2) / renderer->bandHeight;
+            int last = bandMax3(p->y0, p->y1, p->y2) / renderer->bandHeight;
+
+            if (first < 0) first = 0;
+            if (last >= renderer->bandCount) last = renderer->bandCount - 1;
+
+            for (int b = first; b <= last; b++) {
+                if (pass == 0) {
+                    renderer->binStart[b + 1]++;
+                } else {
+                    renderer->binTris[cursor[b]++] = i;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+void BandRenderer_Draw(BandRenderer *renderer, int band, TGAImage *buffer)
+{
+    PROFILE_SCOPE("raster band");
+    int top = band * renderer->bandHeight;
+    int rows = renderer->height - top < renderer->bandHeight ? renderer->height - top : renderer->bandHeight;
+
+    // The last band may be shorter, clipping in tgaSetPixel follows the header
+    buffer->header.height = rows;
+    memset(buffer->pixels, 0, (size_t) renderer->width * rows * sizeof(TGAPixel));
+
+    drawScreenTriangles(renderer->tris, renderer->binTris + renderer->binStart[band],
+                        renderer->binStart[band + 1] - renderer->binStart[band], top, buffer, renderer->color);
+}
+
+void* BandRenderer_Worker(void *arg)
+{
+    BandRenderer *renderer = arg;
+
+    pthread_mutex_lock(&renderer->lock);
+
+    while (renderer->nextBand < renderer->bandCount) {
+        int band = renderer->nextBand++;
+        int slot = band % renderer->bufferCount;
+
+        // Wait until the writer has taken the band that used this slot before.
+        // Counting written bands keeps a later band from claiming the slot first.
+        while (band >= renderer->written + renderer->bufferCount) {
+            pthread_cond_wait(&renderer->changed, &renderer->lock);
+        }
+        renderer->slotBand[slot] = band;
+        renderer->slotDone[slot] = 0;
+        pthread_mutex_unlock(&renderer->lock);
+
+        BandRenderer_Draw(renderer, band, &renderer->buffers[slot]);
+
+        pthread_mutex_lock(&renderer->lock);
+        renderer->slotDone[slot] = 1;
+        pthread_cond_broadcast(&renderer->changed);
+    }
+
+    pthread_mutex_unlock(&renderer->lock);
+
+    return NULL;
+}
+
+// Renders the mesh as a wireframe into a width x height TGA file, bandHeight
+// rows at a time, using threads workers. Returns 0 on success.
+int renderBanded(Mesh *mesh, int width, int height, int bandHeight, int threads, TGAPixel color, const char *path)
+{
+    if (width > 65535 || height > 65535) {
+        fprintf(stderr, "TGA images are limited to 65535 pixels per side\n");
+        return -1;
+    }
+    if (threads < 1) threads = 1;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Failed to open image file");
+        return -1;
+    }
+
+    TGAHeader header = tgaCreateHeader(width, height);
+    if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+        perror("Failed to write image header");
+        close(fd);
+        return -1;
+    }
+
+    BandRenderer renderer = {
+        .bandHeight = bandHeight,
+        .bandCount = (height + bandHeight - 1) / bandHeight,
+        .width = width,
+        .height = height,
+        .bufferCount = threads * 2,
+        .color = color
+    };
+
+    // Everything below lives in one arena: bins, band buffers and bookkeeping.
+    // Only the address space is reserved, pages commit as the bins fill up.
+    size_t bandBytes = (size_t) width * bandHeight * sizeof(TGAPixel);
+    Arena arena = Arena_Create(BAND_ARENA_RESERVE + renderer.bufferCount * (bandBytes + ARENA_ALIGN));
+
+    if (!arena.base || BandRenderer_Bin(&renderer, mesh, &arena) < 0) {
+        Arena_Destroy(&arena);
+        close(fd);
+        return -1;
+    }
+
+    renderer.buffers = ARENA_NEW(&arena, TGAImage, renderer.bufferCount);
+    renderer.slotBand = ARENA_NEW(&arena, int, renderer.bufferCount);
+    renderer.slotDone = ARENA_NEW_ZERO(&arena, int, renderer.bufferCount);
+    for (int i = 0; i < renderer.bufferCount; i++) {
+        renderer.buffers[i] = (TGAImage) {
+            .header = tgaCreateHeader(width, bandHeight),
+            .pixels = ARENA_NEW(&arena, TGAPixel, (size_t) width * bandHeight)
+        };
+        renderer.slotBand[i] = -1;
+    }
+
+    pthread_mutex_init(&renderer.lock, NULL);
+    pthread_cond_init(&renderer.changed, NULL);
+
+    pthread_t *workers = ARENA_NEW(&arena, pthread_t, threads);
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, BandRenderer_Worker, &renderer);
+    }
+
+    // Write the bands in order as they complete
+    int result = 0;
+    for (int band = 0; band < renderer.bandCount; band++) {
+        int slot = band % renderer.bufferCount;
+
+        pthread_mutex_lock(&renderer.lock);
+        while (renderer.slotBand[slot] != band || !renderer.slotDone[slot]) {
+            pthread_cond_wait(&renderer.changed, &renderer.lock);
+        }
+        pthread_mutex_unlock(&renderer.lock);
+
+        PROFILE_SCOPE("save band");
+        TGAImage *buffer = &renderer.buffers[slot];
+        size_t bytes = (size_t) width * buffer->header.height * sizeof(TGAPixel);
+        size_t done = 0;
+        while (done < bytes) {
+            // A short write is not an error, go on from where it stopped
+            ssize_t written = write(fd, (const uint8_t *) buffer->pixels + done, bytes - done);
+            if (written <= 0) {
+                perror("Failed to write band");
+                result = -1;
+                break;
+            }
+            done += written;
+        }
+
+        pthread_mutex_lock(&renderer.lock);
+        renderer.written++;
+        pthread_cond_broadcast(&renderer.changed);
+        pthread_mutex_unlock(&renderer.lock);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    PROFILE_SAMPLE();
+
+    close(fd);
+
+    Arena_Destroy(&arena);
+    pthread_mutex_destroy(&renderer.lock);
+    pthread_cond_destroy(&renderer.changed);
+
+    return result;
+}
+
+#endif
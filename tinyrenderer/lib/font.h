@@ -0,0 +1,327 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "tga.h"
+
+// Software text rendering for HUD overlays. The 8x16 bitmap font below is
+// baked once into an 8-bit coverage atlas at an integer scale, together with
+// the covered span of every glyph row, so drawing a string only touches
+// pixels that actually receive ink. Works on any CPU side surface: the TGA
+// image, a DRM dumb buffer or an X11 present buffer.
+
+#define FONT_GLYPH_WIDTH 8
+#define FONT_GLYPH_HEIGHT 16
+#define FONT_FIRST_CHAR 32
+#define FONT_LAST_CHAR 126
+#define FONT_GLYPHS (FONT_LAST_CHAR - FONT_FIRST_CHAR + 1)
+
+// Printable ASCII, one byte per row, most significant bit on the left.
+// Rasterized from DejaVu Sans Mono at 13px.
+const uint8_t fontBitmap[FONT_GLYPHS][FONT_GLYPH_HEIGHT] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+    { 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00 }, // '!'
+    { 0x00, 0x00, 0x00, 0x00, 0x28, 0x28, 0x28, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '"'
+    { 0x00, 0x00, 0x00, 0x12, 0x12, 0x16, 0x7F, 0x24, 0x24, 0xFE, 0x28, 0x48, 0x48, 0x00, 0x00, 0x00 }, // '#'
+    { 0x00, 0x00, 0x00, 0x00, 0x08, 0x3E, 0x49, 0x48, 0x38, 0x0E, 0x09, 0x49, 0x3E, 0x08, 0x08, 0x00 }, // '$'
+    { 0x00, 0x00, 0x00, 0x00, 0x60, 0x90, 0x90, 0x62, 0x1C, 0x66, 0x09, 0x09, 0x06, 0x00, 0x00, 0x00 }, // '%'
+    { 0x00, 0x00, 0x00, 0x00, 0x1C, 0x20, 0x20, 0x30, 0x49, 0x4D, 0x45, 0x62, 0x3D, 0x00, 0x00, 0x00 }, // '&'
+    { 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '''
+    { 0x00, 0x00, 0x0C, 0x08, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x08, 0x08, 0x04, 0x00, 0x00 }, // '('
+    { 0x00, 0x00, 0x30, 0x10, 0x10, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x10, 0x10, 0x30, 0x00, 0x00 }, // ')'
+    { 0x00, 0x00, 0x00, 0x00, 0x08, 0x49, 0x3E, 0x1C, 0x6B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '*'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0xFE, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00 }, // '+'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x10, 0x20, 0x00 }, // ','
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '-'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00 }, // '.'
+    { 0x00, 0x00, 0x00, 0x00, 0x02, 0x04, 0x04, 0x08, 0x08, 0x18, 0x10, 0x10, 0x20, 0x20, 0x40, 0x00 }, // '/'
+    { 0x00, 0x00, 0x00, 0x00, 0x1C, 0x22, 0x41, 0x41, 0x49, 0x41, 0x41, 0x22, 0x1C, 0x00, 0x00, 0x00 }, // '0'
+    { 0x00, 0x00, 0x00, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x3E, 0x00, 0x00, 0x00 }, // '1'
+    { 0x00, 0x00, 0x00, 0x00, 0x3E, 0x43, 0x01, 0x01, 0x02, 0x0C, 0x18, 0x20, 0x7F, 0x00, 0x00, 0x00 }, // '2'
+    { 0x00, 0x00, 0x00, 0x00, 0x3E, 0x41, 0x01, 0x03, 0x1C, 0x03, 0x01, 0x43, 0x3E, 0x00, 0x00, 0x00 }, // '3'
+    { 0x00, 0x00, 0x00, 0x00, 0x06, 0x0A, 0x1A, 0x12, 0x22, 0x42, 0x7F, 0x02, 0x02, 0x00, 0x00, 0x00 }, // '4'
+    { 0x00, 0x00, 0x00, 0x00, 0x7E, 0x40, 0x40, 0x7C, 0x03, 0x01, 0x01, 0x43, 0x3C, 0x00, 0x00, 0x00 }, // '5'
+    { 0x00, 0x00, 0x00, 0x00, 0x1E, 0x21, 0x40, 0x5E, 0x63, 0x41, 0x41, 0x23, 0x1E, 0x00, 0x00, 0x00 }, // '6'
+    { 0x00, 0x00, 0x00, 0x00, 0x7F, 0x02, 0x02, 0x04, 0x04, 0x08, 0x18, 0x10, 0x20, 0x00, 0x00, 0x00 }, // '7'
+    { 0x00, 0x00, 0x00, 0x00, 0x3E, 0x41, 0x41, 0x41, 0x3E, 0x63, 0x41, 0x61, 0x3E, 0x00, 0x00, 0x00 }, // '8'
+    { 0x00, 0x00, 0x00, 0x00, 0x3C, 0x62, 0x41, 0x41, 0x63, 0x3D, 0x01, 0x42, 0x3C, 0x00, 0x00, 0x00 }, // '9'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00 }, // ':'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x10, 0x20, 0x00 }, // ';'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x0E, 0x70, 0x70, 0x0E, 0x01, 0x00, 0x00, 0x00, 0x00 }, // '<'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7F, 0x00, 0x00, 0x7F, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '='
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x38, 0x07, 0x07, 0x38, 0x40, 0x00, 0x00, 0x00, 0x00 }, // '>'
+    { 0x00, 0x00, 0x00, 0x00, 0x38, 0x44, 0x04, 0x08, 0x10, 0x10, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00 }, // '?'
+    { 0x00, 0x00, 0x00, 0x00, 0x1E, 0x33, 0x21, 0x47, 0x49, 0x49, 0x49, 0x47, 0x20, 0x30, 0x1E, 0x00 }, // '@'
+    { 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x14, 0x14, 0x22, 0x22, 0x3E, 0x63, 0x41, 0x00, 0x00, 0x00 }, // 'A'
+    { 0x00, 0x00, 0x00, 0x00, 0x7E, 0x41, 0x41, 0x41, 0x7E, 0x41, 0x41, 0x41, 0x7E, 0x00, 0x00, 0x00 }, // 'B'
+    { 0x00, 0x00, 0x00, 0x00, 0x1E, 0x21, 0x40, 0x40, 0x40, 0x40, 0x40, 0x21, 0x1E, 0x00, 0x00, 0x00 }, // 'C'
+    { 0x00, 0x00, 0x00, 0x00, 0x7C, 0x42, 0x41, 0x41, 0x41, 0x41, 0x41, 0x42, 0x7C, 0x00, 0x00, 0x00 }, // 'D'
+    { 0x00, 0x00, 0x00, 0x00, 0x7F, 0x40, 0x40, 0x40, 0x7F, 0x40, 0x40, 0x40, 0x7F, 0x00, 0x00, 0x00 }, // 'E'
+    { 0x00, 0x00, 0x00, 0x00, 0x7F, 0x40, 0x40, 0x40, 0x7F, 0x40, 0x40, 0x40, 0x40, 0x00, 0x00, 0x00 }, // 'F'
+    { 0x00, 0x00, 0x00, 0x00, 0x1E, 0x21, 0x40, 0x40, 0x43, 0x41, 0x41, 0x21, 0x1E, 0x00, 0x00, 0x00 }, // 'G'
+    { 0x00, 0x00, 0x00, 0x00, 0x41, 0x41, 0x41, 0x41, 0x7F, 0x41, 0x41, 0x41, 0x41, 0x00, 0x00, 0x00 }, // 'H'
+    { 0x00, 0x00, 0x00, 0x00, 0x7C, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x7C, 0x00, 0x00, 0x00 }, // 'I'
+    { 0x00, 0x00, 0x00, 0x00, 0x1C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x44, 0x38, 0x00, 0x00, 0x00 }, // 'J'
+    { 0x00, 0x00, 0x00, 0x00, 0x42, 0x44, 0x48, 0x50, 0x70, 0x48, 0x44, 0x44, 0x42, 0x00, 0x00, 0x00 }, // 'K'
+    { 0x00, 0x00, 0x00, 0x00, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7F, 0x00, 0x00, 0x00 }, // 'L'
+    { 0x00, 0x00, 0x00, 0x00, 0x63, 0x63, 0x55, 0x55, 0x55, 0x49, 0x41, 0x41, 0x41, 0x00, 0x00, 0x00 }, // 'M'
+    { 0x00, 0x00, 0x00, 0x00, 0x61, 0x61, 0x51, 0x51, 0x49, 0x45, 0x45, 0x43, 0x43, 0x00, 0x00, 0x00 }, // 'N'
+    { 0x00, 0x00, 0x00, 0x00, 0x1C, 0x22, 0x41, 0x41, 0x41, 0x41, 0x41, 0x22, 0x1C, 0x00, 0x00, 0x00 }, // 'O'
+    { 0x00, 0x00, 0x00, 0x00, 0x7E, 0x43, 0x41, 0x41, 0x43, 0x7E, 0x40, 0x40, 0x40, 0x00, 0x00, 0x00 }, // 'P'
+    { 0x00, 0x00, 0x00, 0x00, 0x1C, 0x22, 0x41, 0x41, 0x41, 0x41, 0x41, 0x23, 0x1E, 0x06, 0x02, 0x00 }, // 'Q'
+    { 0x00, 0x00, 0x00, 0x00, 0x7E, 0x43, 0x41, 0x41, 0x7E, 0x42, 0x41, 0x41, 0x41, 0x00, 0x00, 0x00 }, // 'R'
+    { 0x00, 0x00, 0x00, 0x00, 0x3E, 0x61, 0x40, 0x60, 0x3E, 0x03, 0x01, 0x43, 0x3E, 0x00, 0x00, 0x00 }, // 'S'
+    { 0x00, 0x00, 0x00, 0x00, 0xFE, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 }, // 'T'
+    { 0x00, 0x00, 0x00, 0x00, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x3E, 0x00, 0x00, 0x00 }, // 'U'
+    { 0x00, 0x00, 0x00, 0x00, 0x41, 0x63, 0x22, 0x22, 0x22, 0x14, 0x14, 0x14, 0x08, 0x00, 0x00, 0x00 }, // 'V'
+    { 0x00, 0x00, 0x00, 0x00, 0x81, 0x81, 0x81, 0x5A, 0x5A, 0x5A, 0x66, 0x66, 0x66, 0x00, 0x00, 0x00 }, // 'W'
+    { 0x00, 0x00, 0x00, 0x00, 0x63, 0x22, 0x14, 0x1C, 0x08, 0x14, 0x36, 0x22, 0x41, 0x00, 0x00, 0x00 }, // 'X'
+    { 0x00, 0x00, 0x00, 0x00, 0x82, 0x44, 0x28, 0x28, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 }, // 'Y'
+    { 0x00, 0x00, 0x00, 0x00, 0x7F, 0x03, 0x06, 0x04, 0x08, 0x10, 0x30, 0x60, 0x7F, 0x00, 0x00, 0x00 }, // 'Z'
+    { 0x00, 0x00, 0x1C, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1C, 0x00, 0x00 }, // '['
+    { 0x00, 0x00, 0x00, 0x00, 0x40, 0x20, 0x20, 0x10, 0x10, 0x18, 0x08, 0x08, 0x04, 0x04, 0x02, 0x00 }, // '\'
+    { 0x00, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00, 0x00 }, // ']'
+    { 0x00, 0x00, 0x00, 0x00, 0x10, 0x28, 0x44, 0xC6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '^'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF }, // '_'
+    { 0x00, 0x00, 0x00, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '`'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x22, 0x02, 0x3E, 0x42, 0x46, 0x3A, 0x00, 0x00, 0x00 }, // 'a'
+    { 0x00, 0x00, 0x40, 0x40, 0x40, 0x40, 0x7C, 0x66, 0x42, 0x42, 0x42, 0x66, 0x7C, 0x00, 0x00, 0x00 }, // 'b'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x22, 0x40, 0x40, 0x40, 0x22, 0x1C, 0x00, 0x00, 0x00 }, // 'c'
+    { 0x00, 0x00, 0x02, 0x02, 0x02, 0x02, 0x3E, 0x66, 0x42, 0x42, 0x42, 0x66, 0x3E, 0x00, 0x00, 0x00 }, // 'd'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x66, 0x42, 0x7E, 0x40, 0x62, 0x3C, 0x00, 0x00, 0x00 }, // 'e'
+    { 0x00, 0x00, 0x0C, 0x10, 0x10, 0x10, 0x7C, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 }, // 'f'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x66, 0x42, 0x42, 0x42, 0x66, 0x3A, 0x02, 0x22, 0x1C }, // 'g'
+    { 0x00, 0x00, 0x40, 0x40, 0x40, 0x40, 0x5C, 0x62, 0x42, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00 }, // 'h'
+    { 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x7C, 0x00, 0x00, 0x00 }, // 'i'
+    { 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x70 }, // 'j'
+    { 0x00, 0x00, 0x40, 0x40, 0x40, 0x40, 0x44, 0x48, 0x50, 0x70, 0x48, 0x44, 0x42, 0x00, 0x00, 0x00 }, // 'k'
+    { 0x00, 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x0E, 0x00, 0x00, 0x00 }, // 'l'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7F, 0x49, 0x49, 0x49, 0x49, 0x49, 0x49, 0x00, 0x00, 0x00 }, // 'm'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5C, 0x62, 0x42, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00 }, // 'n'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x66, 0x42, 0x42, 0x42, 0x66, 0x3C, 0x00, 0x00, 0x00 }, // 'o'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x66, 0x42, 0x42, 0x42, 0x66, 0x7C, 0x40, 0x40, 0x40 }, // 'p'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x66, 0x42, 0x42, 0x42, 0x66, 0x3A, 0x02, 0x02, 0x02 }, // 'q'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x32, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00 }, // 'r'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x42, 0x40, 0x3C, 0x02, 0x42, 0x3C, 0x00, 0x00, 0x00 }, // 's'
+    { 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x7E, 0x10, 0x10, 0x10, 0x10, 0x10, 0x0E, 0x00, 0x00, 0x00 }, // 't'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x46, 0x3A, 0x00, 0x00, 0x00 }, // 'u'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x66, 0x24, 0x24, 0x3C, 0x18, 0x18, 0x00, 0x00, 0x00 }, // 'v'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 0x81, 0x5A, 0x5A, 0x5A, 0x24, 0x24, 0x00, 0x00, 0x00 }, // 'w'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x24, 0x18, 0x18, 0x18, 0x24, 0x66, 0x00, 0x00, 0x00 }, // 'x'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x22, 0x24, 0x24, 0x14, 0x18, 0x08, 0x08, 0x10, 0x30 }, // 'y'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x02, 0x04, 0x18, 0x20, 0x40, 0x7E, 0x00, 0x00, 0x00 }, // 'z'
+    { 0x00, 0x00, 0x1C, 0x10, 0x10, 0x10, 0x10, 0x60, 0x10, 0x10, 0x10, 0x10, 0x10, 0x0C, 0x00, 0x00 }, // '{'
+    { 0x00, 0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00 }, // '|'
+    { 0x00, 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x0C, 0x10, 0x10, 0x10, 0x10, 0x10, 0x60, 0x00, 0x00 }, // '}'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x39, 0x46, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }  // '~'
+};
+
+typedef struct {
+    uint16_t start;             // First covered column of the row
+    uint16_t length;            // Number of columns up to the last covered one
+} FontSpan;
+
+typedef struct {
+    uint16_t top;               // First row with any coverage
+    uint16_t bottom;            // One past the last row with coverage
+} FontGlyphRows;
+
+typedef struct {
+    int scale;
+    int glyphWidth;             // Scaled cell size
+    int glyphHeight;
+    uint8_t *coverage;          // FONT_GLYPHS cells side by side, glyphWidth * FONT_GLYPHS per row
+    int pitch;
+    FontSpan *spans;            // glyphHeight spans per glyph
+    FontGlyphRows *rows;
+} FontAtlas;
+
+FontAtlas* FontAtlas_Create(int scale)
+{
+    FontAtlas *atlas = malloc(sizeof(FontAtlas));
+
+    atlas->scale = scale;
+    atlas->glyphWidth = FONT_GLYPH_WIDTH * scale;
+    atlas->glyphHeight = FONT_GLYPH_HEIGHT * scale;
+    atlas->pitch = atlas->glyphWidth * FONT_GLYPHS;
+    atlas->coverage = calloc(atlas->pitch * atlas->glyphHeight, 1);
+    atlas->spans = calloc(FONT_GLYPHS * atlas->glyphHeight, sizeof(FontSpan));
+    atlas->rows = calloc(FONT_GLYPHS, sizeof(FontGlyphRows));
+
+    for (int g = 0; g < FONT_GLYPHS; g++) {
+        FontGlyphRows *rows = &atlas->rows[g];
+        rows->top = atlas->glyphHeight;
+        rows->bottom = 0;
+
+        for (int y = 0; y < atlas->glyphHeight; y++) {
+            uint8_t bits = fontBitmap[g][y / scale];
+            uint8_t *cell = atlas->coverage + y * atlas->pitch + g * atlas->glyphWidth;
+            FontSpan *span = &atlas->spans[g * atlas->glyphHeight + y];
+
+            if (!bits) continue;
+
+            int first = -1, last = -1;
+            for (int x = 0; x < atlas->glyphWidth; x++) {
+                if (bits & (0x80 >> (x / scale))) {
+                    cell[x] = 255;
+                    if (first < 0) first = x;
+                    last = x;
+                }
+            }
+
+            span->start = first;
+            span->length = last - first + 1;
+
+            if (y < rows->top) rows->top = y;
+            rows->bottom = y + 1;
+        }
+    }
+
+    return atlas;
+}
+
+void FontAtlas_Destroy(FontAtlas *atlas)
+{
+    free(atlas->coverage);
+    free(atlas->spans);
+    free(atlas->rows);
+    free(atlas);
+}
+
+int Font_TextWidth(FontAtlas *atlas, const char *text)
+{
+    return strlen(text) * atlas->glyphWidth;
+}
+
+// Blends count pixels of color over dst, weighted by coverage * alpha / 255
+void Font_BlendSpan32(uint32_t *dst, const uint8_t *coverage, int count, uint32_t color, uint8_t alpha)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32(color), zero);
+    const __m128i a = _mm_set1_epi16(alpha);
+
+    for (; i + 4 <= count; i += 4) {
+        uint32_t mask;
+        memcpy(&mask, coverage + i, sizeof(mask));
+        if (!mask) continue;
+
+        // Per pixel weight = coverage * alpha / 255, broadcast to all four channels
+        __m128i w = _mm_unpacklo_epi8(_mm_cvtsi32_si128(mask), zero);
+        w = _mm_add_epi16(_mm_mullo_epi16(w, a), c128);
+        w = _mm_srli_epi16(_mm_add_epi16(w, _mm_srli_epi16(w, 8)), 8);
+        w = _mm_unpacklo_epi16(w, w);
+        __m128i wLo = _mm_unpacklo_epi32(w, w);
+        __m128i wHi = _mm_unpackhi_epi32(w, w);
+
+        __m128i d = _mm_loadu_si128((__m128i *) (dst + i));
+        __m128i dLo = _mm_unpacklo_epi8(d, zero);
+        __m128i dHi = _mm_unpackhi_epi8(d, zero);
+
+        // (src * w + dst * (255 - w)) / 255, rounded
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(src, wLo), _mm_mullo_epi16(dLo, _mm_sub_epi16(c255, wLo)));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(src, wHi), _mm_mullo_epi16(dHi, _mm_sub_epi16(c255, wHi)));
+        lo = _mm_add_epi16(lo, c128);
+        hi = _mm_add_epi16(hi, c128);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; i < count; i++) {
+        int w = (coverage[i] * alpha + 127) / 255;
+        if (!w) continue;
+
+        if (w == 255) {
+            dst[i] = color;
+            continue;
+        }
+
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int s = (color >> shift) & 0xFF;
+            int d = (dst[i] >> shift) & 0xFF;
+            out |= ((s * w + d * (255 - w) + 127) / 255) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+void Font_BlendSpanTGA(TGAPixel *dst, const uint8_t *coverage, int count, TGAPixel color, uint8_t alpha)
+{
+    for (int i = 0; i < count; i++) {
+        int w = (coverage[i] * alpha + 127) / 255;
+        if (!w) continue;
+
+        if (w == 255) {
+            dst[i] = color;
+            continue;
+        }
+
+        dst[i].B = (color.B * w + dst[i].B * (255 - w) + 127) / 255;
+        dst[i].G = (color.G * w + dst[i].G * (255 - w) + 127) / 255;
+        dst[i].R = (color.R * w + dst[i].R * (255 - w) + 127) / 255;
+    }
+}
+
+// Draws text with its top left corner at x, y. The surface is either
+// XRGB8888 (bytesPerPixel 4) or BGR24 like TGAPixel (bytesPerPixel 3),
+// pitch is the length of a row in bytes. color is 0x00RRGGBB.
+void Font_DrawText(FontAtlas *atlas, uint8_t *pixels, int bytesPerPixel, int pitch, int width, int height,
+                   int x, int y, const char *text, uint32_t color, uint8_t alpha)
+{
+    TGAPixel color24 = { .B = color & 0xFF, .G = (color >> 8) & 0xFF, .R = (color >> 16) & 0xFF };
+
+    for (const char *c = text; *c; c++, x += atlas->glyphWidth) {
+        if (*c < FONT_FIRST_CHAR || *c > FONT_LAST_CHAR) continue;
+        if (x >= width || x + atlas->glyphWidth <= 0) continue;
+
+        int glyph = *c - FONT_FIRST_CHAR;
+        FontGlyphRows rows = atlas->rows[glyph];
+
+        for (int gy = rows.top; gy < rows.bottom; gy++) {
+            int py = y + gy;
+            if (py < 0 || py >= height) continue;
+
+            FontSpan span = atlas->spans[glyph * atlas->glyphHeight + gy];
+            int gx = span.start;
+            int count = span.length;
+
+            if (x + gx < 0) {
+                count += x + gx;
+                gx = -x;
+            }
+            if (x + gx + count > width) count = width - x - gx;
+            if (count <= 0) continue;
+
+            const uint8_t *coverage = atlas->coverage + gy * atlas->pitch + glyph * atlas->glyphWidth + gx;
+            uint8_t *dst = pixels + (size_t) py * pitch + (x + gx) * bytesPerPixel;
+
+            if (bytesPerPixel == 4) {
+                Font_BlendSpan32((uint32_t *) dst, coverage, count, color, alpha);
+            } else {
+                Font_BlendSpanTGA((TGAPixel *) dst, coverage, count, color24, alpha);
+            }
+        }
+    }
+}
+
+void Font_DrawTextTGA(FontAtlas *atlas, TGAImage *image, int x, int y, const char *text, TGAPixel color, uint8_t alpha)
+{
+    Font_DrawText(atlas, (uint8_t *) image->pixels, sizeof(TGAPixel), image->header.width * sizeof(TGAPixel),
+                  image->header.width, image->header.height,
+                  x, y, text, (color.R << 16) | (color.G << 8) | color.B, alpha);
+}
+
+#endif
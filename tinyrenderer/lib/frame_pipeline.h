@@ -0,0 +1,196 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "tga.h"
+#include "wavefront_obj.h"
+#include "render.h"
+#include "font.h"
+#include "arena.h"
+#include "surface.h"
+#include "spsc_ring.h"
+#include "tga_writer.h"
+#include "profile.h"
+
+// Turntable sequences as a three stage pipeline. The calling thread
+// transforms frame N+1 while a raster thread draws frame N and a writer
+// thread saves frame N-1. Frames travel between the stages through SPSC
+// rings and come back to the transform stage through a third ring once
+// written, so at most inFlight frames exist at any time and nothing is
+// allocated after start up. Throughput follows the slowest stage rather
+// than the sum of all three.
+
+enum { PIPELINE_TRANSFORM, PIPELINE_RASTER, PIPELINE_WRITE, PIPELINE_STAGES };
+
+typedef struct {
+    int frame;                  // -1 tells the later stages to finish
+    uint64_t started;           // PROFILE_NOW() when the transform began
+    Arena arena;                // Transform output, reset when the frame comes round again
+    ScreenTriangle *tris;
+    TGAWriterSlot slot;
+} PipelineFrame;
+
+typedef struct {
+    Mesh *mesh;
+    int frames;
+    int writerFlags;
+    FontAtlas *font;            // HUD with the raster time when set
+    double slowFrameMs;         // Frames slower than this from transform to written leave a trace
+    SPSCRing transformed;       // Transform -> raster
+    SPSCRing rastered;          // Raster -> write
+    SPSCRing written;           // Write -> transform, the free frames
+    double busyMs[PIPELINE_STAGES];
+    int failures;
+} FramePipeline;
+
+static inline double pipelineNowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+void* FramePipeline_Raster(void *arg)
+{
+    FramePipeline *pipeline = arg;
+
+    PROFILE_THREAD_NAME("raster");
+
+    for (;;) {
+        PipelineFrame *frame = SPSCRing_PopWait(&pipeline->transformed);
+        if (frame->frame < 0) {
+            SPSCRing_Push(&pipeline->rastered, frame);
+            break;
+        }
+
+        double start = pipelineNowMs();
+        TGAImage *image = &frame->slot.image;
+
+        surfaceFill24(image->pixels, (size_t) image->header.width * image->header.height, black);
+        if (frame->tris) drawScreenTriangles(frame->tris, NULL, pipeline->mesh->trisSize, 0, image, red);
+
+        if (pipeline->font) {
+            char text[64];
+            snprintf(text, sizeof(text), "frame %d  raster: %.3f ms", frame->frame, pipelineNowMs() - start);
+            Font_DrawTextTGA(pipeline->font, image, 8, 8, text, white, 255);
+        }
+
+        snprintf(frame->slot.path, sizeof(frame->slot.path), "frame_%04d.tga", frame->frame);
+        pipeline->busyMs[PIPELINE_RASTER] += pipelineNowMs() - start;
+
+        SPSCRing_Push(&pipeline->rastered, frame);
+    }
+
+    return NULL;
+}
+
+void* FramePipeline_Write(void *arg)
+{
+    FramePipeline *pipeline = arg;
+
+    PROFILE_THREAD_NAME("writer");
+
+    for (;;) {
+        PipelineFrame *frame = SPSCRing_PopWait(&pipeline->rastered);
+        if (frame->frame < 0) break;
+
+        double start = pipelineNowMs();
+        if (TGAWriterSlot_Write(&frame->slot, pipeline->writerFlags) < 0) pipeline->failures++;
+        pipeline->busyMs[PIPELINE_WRITE] += pipelineNowMs() - start;
+
+        PROFILE_SAMPLE();
+
+        uint64_t finished = PROFILE_NOW();
+        if (pipeline->slowFrameMs > 0 && (finished - frame->started) / 1e6 > pipeline->slowFrameMs) {
+            char path[32];
+            snprintf(path, sizeof(path), "slow_frame_%04d.json", frame->frame);
+            (void) PROFILE_WRITE_WINDOW(path, frame->started, finished);
+        }
+
+        SPSCRing_Push(&pipeline->written, frame);
+    }
+
+    return NULL;
+}
+
+// Renders frames turntable frames of mesh as frame_0000.tga, ... with at most
+// inFlight frames between the stages. Per stage busy times end up in busyMs.
+// In PROFILE builds a frame slower than slowFrameMs, when above 0, is written
+// out as slow_frame_NNNN.json covering all threads.
+// Returns the number of frames that failed to write.
+int renderPipelined(Mesh *mesh, int width, int height, int frames, int inFlight, int writerFlags,
+                    FontAtlas *font, double slowFrameMs, double busyMs[PIPELINE_STAGES])
+{
+    FramePipeline pipeline = {
+        .mesh = mesh,
+        .frames = frames,
+        .writerFlags = writerFlags,
+        .font = font,
+        .slowFrameMs = slowFrameMs
+    };
+    PipelineFrame *contexts = calloc(inFlight, sizeof(PipelineFrame));
+    pthread_t raster, writer;
+
+    // Every ring can hold all frames at once, so a push never finds it full
+    SPSCRing_Init(&pipeline.transformed, inFlight);
+    SPSCRing_Init(&pipeline.rastered, inFlight);
+    SPSCRing_Init(&pipeline.written, inFlight);
+
+    for (int i = 0; i < inFlight; i++) {
+        contexts[i].arena = Arena_Create((size_t) 1 << 30);
+        TGAWriterSlot_Init(&contexts[i].slot, width, height);
+        SPSCRing_Push(&pipeline.written, &contexts[i]);
+    }
+
+    pthread_create(&raster, NULL, FramePipeline_Raster, &pipeline);
+    pthread_create(&writer, NULL, FramePipeline_Write, &pipeline);
+
+    size_t heapAllocations = ARENA_HEAP_COUNT();
+
+    for (int n = 0; n <= frames; n++) {
+        PipelineFrame *frame = SPSCRing_PopWait(&pipeline.written);
+
+        // Once a frame has made it round the pipeline no stage should touch the heap
+        if (n <= inFlight) heapAllocations = ARENA_HEAP_COUNT();
+        ARENA_ASSERT_NO_HEAP(heapAllocations);
+
+        if (n == frames) {
+            frame->frame = -1;
+            SPSCRing_Push(&pipeline.transformed, frame);
+            break;
+        }
+
+        double start = pipelineNowMs();
+
+        Arena_Reset(&frame->arena);
+        frame->frame = n;
+        frame->started = PROFILE_NOW();
+        frame->tris = transformMeshRotated(mesh, width, height, 2 * M_PI * n / frames, &frame->arena);
+        pipeline.busyMs[PIPELINE_TRANSFORM] += pipelineNowMs() - start;
+
+        SPSCRing_Push(&pipeline.transformed, frame);
+    }
+
+    pthread_join(raster, NULL);
+    pthread_join(writer, NULL);
+
+    for (int i = 0; i < inFlight; i++) {
+        Arena_Destroy(&contexts[i].arena);
+        free(contexts[i].slot.block);
+    }
+    free(contexts);
+    SPSCRing_Destroy(&pipeline.transformed);
+    SPSCRing_Destroy(&pipeline.rastered);
+    SPSCRing_Destroy(&pipeline.written);
+
+    for (int i = 0; i < PIPELINE_STAGES; i++) busyMs[i] = pipeline.busyMs[i];
+
+    return pipeline.failures;
+}
+
+#endif
@@ -0,0 +1,440 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <linux/input.h>
+
+// Event driven evdev input. Devices under /dev/input are picked by what they
+// can report, every fd sits in one epoll set and Input_Poll sleeps in
+// epoll_wait until something arrives, so an idle program uses no CPU.
+//
+// Events are read in arrays and folded into per device state. Nothing is
+// handed out per event: when a SYN_REPORT closes a frame the handler gets
+// one InputFrame with the absolute axes, the relative motion summed over the
+// frame, the multitouch slots and the key bitmap. After a SYN_DROPPED the
+// rest of the frame is thrown away and the state is read back with ioctls.
+//
+// Input_AddFd takes any fd that yields struct input_event records, such as a
+// uinput device or a pipe, and Input_Feed takes events from memory, which is
+// how recorded input gets replayed through the same path. A tap sees the raw
+// events frame by frame once they are folded, for recording, so after a
+// SYN_DROPPED it finds the device state already read back.
+
+#define INPUT_MAX_DEVICES 32
+#define INPUT_MAX_SLOTS 16
+#define INPUT_READ_EVENTS 64
+
+// Capabilities, also used to choose which devices to open
+#define INPUT_POINTER 1         // REL_X/REL_Y or ABS_X/ABS_Y
+#define INPUT_TOUCH 2           // Multitouch slots
+#define INPUT_KEYBOARD 4        // Letter keys
+#define INPUT_ALL 7
+
+// What a frame changed
+#define INPUT_CHANGED_ABS 1
+#define INPUT_CHANGED_REL 2
+#define INPUT_CHANGED_TOUCH 4
+#define INPUT_CHANGED_KEYS 8
+
+#define INPUT_BIT(bits, n) (((bits)[(n) / 8] >> ((n) % 8)) & 1)
+
+typedef struct {
+    int active;
+    int trackingId;
+    int x, y;
+    int pressure;
+} InputSlot;
+
+typedef struct {
+    int min, max;
+} InputAxis;
+
+typedef struct {
+    int index;
+    const char *name;
+    int capabilities;
+    InputAxis axisX, axisY;     // Range of ABS_X/ABS_Y or of the multitouch positions
+} InputDeviceInfo;
+
+typedef struct {
+    const InputDeviceInfo *device;
+    uint64_t timeUs;            // Kernel timestamp of the SYN_REPORT, CLOCK_MONOTONIC for evdev nodes
+    uint32_t changed;           // INPUT_CHANGED_* bits
+    int events;                 // Raw events folded into this frame
+    int x, y, pressure;         // Absolute axes, kept between frames
+    int dx, dy, wheel;          // Relative motion during this frame only
+    int touches;                // Active slots
+    InputSlot slots[INPUT_MAX_SLOTS];
+    uint8_t keys[KEY_CNT / 8];  // Keys held down at the end of the frame
+} InputFrame;
+
+typedef void (*InputHandler)(const InputFrame *frame, void *user);
+typedef void (*InputTap)(int device, const struct input_event *events, int count, void *user);
+
+typedef struct {
+    int fd;
+    int evdev;                  // Accepts evdev ioctls, pipes and replays do not
+    int dropping;               // Skipping to the next SYN_REPORT after SYN_DROPPED
+    int slot;                   // Slot that ABS_MT_* events currently address, -1 when untracked
+    int partialBytes;           // Start of a record a pipe delivered only in part
+    uint8_t partial[sizeof(struct input_event)];
+    char name[64];
+    InputDeviceInfo info;
+    InputFrame frame;
+} InputDevice;
+
+typedef struct {
+    int epoll;
+    int count;
+    InputTap tap;               // Optional, see Input_Feed
+    void *tapUser;
+    InputDevice devices[INPUT_MAX_DEVICES];
+} Input;
+
+int Input_Init(Input *input)
+{
+    memset(input, 0, sizeof(*input));
+    input->epoll = epoll_create1(EPOLL_CLOEXEC);
+
+    return input->epoll < 0 ? -1 : 0;
+}
+
+// What the evdev node behind fd reports, as INPUT_* bits
+int Input_Capabilities(int fd)
+{
+    uint8_t types[EV_CNT / 8 + 1] = { 0 }, rel[REL_CNT / 8 + 1] = { 0 };
+    uint8_t abs[ABS_CNT / 8 + 1] = { 0 }, keys[KEY_CNT / 8 + 1] = { 0 };
+    int capabilities = 0;
+
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(types)), types) < 0) return 0;
+    ioctl(fd, EVIOCGBIT(EV_REL, sizeof(rel)), rel);
+    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs)), abs);
+    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys);
+
+    if (INPUT_BIT(types, EV_REL) && INPUT_BIT(rel, REL_X) && INPUT_BIT(rel, REL_Y)) capabilities |= INPUT_POINTER;
+    if (INPUT_BIT(types, EV_ABS) && INPUT_BIT(abs, ABS_X) && INPUT_BIT(abs, ABS_Y)) capabilities |= INPUT_POINTER;
+    if (INPUT_BIT(types, EV_ABS) && INPUT_BIT(abs, ABS_MT_SLOT)) capabilities |= INPUT_TOUCH;
+    if (INPUT_BIT(types, EV_KEY) && INPUT_BIT(keys, KEY_A) && INPUT_BIT(keys, KEY_Z)) capabilities |= INPUT_KEYBOARD;
+
+    return capabilities;
+}
+
+// Reads the whole state back from the kernel, at startup and after SYN_DROPPED
+void Input_Resync(InputDevice *device)
+{
+    InputFrame *frame = &device->frame;
+    struct input_absinfo info;
+
+    if (!device->evdev) return;
+
+    if (ioctl(device->fd, EVIOCGABS(ABS_X), &info) == 0) frame->x = info.value;
+    if (ioctl(device->fd, EVIOCGABS(ABS_Y), &info) == 0) frame->y = info.value;
+    if (ioctl(device->fd, EVIOCGABS(ABS_PRESSURE), &info) == 0) frame->pressure = info.value;
+    if (ioctl(device->fd, EVIOCGABS(ABS_MT_SLOT), &info) == 0) {
+        device->slot = info.value >= 0 && info.value < INPUT_MAX_SLOTS ? info.value : -1;
+    }
+    ioctl(device->fd, EVIOCGKEY(sizeof(frame->keys)), frame->keys);
+
+    if (device->info.capabilities & INPUT_TOUCH) {
+        const int codes[] = { ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y, ABS_MT_PRESSURE };
+        struct { uint32_t code; int32_t values[INPUT_MAX_SLOTS]; } request;
+
+        for (int c = 0; c < 4; c++) {
+            memset(&request, 0, sizeof(request));
+            request.code = codes[c];
+            if (ioctl(device->fd, EVIOCGMTSLOTS(sizeof(request)), &request) < 0) continue;
+
+            for (int s = 0; s < INPUT_MAX_SLOTS; s++) {
+                InputSlot *slot = &frame->slots[s];
+                int value = request.values[s];
+
+                if (codes[c] == ABS_MT_TRACKING_ID) {
+                    slot->trackingId = value;
+                    slot->active = value >= 0;
+                }
+                else if (codes[c] == ABS_MT_POSITION_X) slot->x = value;
+                else if (codes[c] == ABS_MT_POSITION_Y) slot->y = value;
+                else slot->pressure = value;
+            }
+        }
+    }
+
+    frame->touches = 0;
+    for (int s = 0; s < INPUT_MAX_SLOTS; s++) frame->touches += frame->slots[s].active;
+}
+
+// Adds a device without an fd, whose events only come through Input_Feed.
+// Returns its index.
+int Input_AddDevice(Input *input, const char *name, int capabilities)
+{
+    if (input->count == INPUT_MAX_DEVICES) return -1;
+
+    int index = input->count++;
+    InputDevice *device = &input->devices[index];
+
+    memset(device, 0, sizeof(*device));
+    device->fd = -1;
+    snprintf(device->name, sizeof(device->name), "%s", name);
+    device->info.index = index;
+    device->info.name = device->name;
+    device->info.capabilities = capabilities;
+    device->frame.device = &device->info;
+    for (int s = 0; s < INPUT_MAX_SLOTS; s++) device->frame.slots[s].trackingId = -1;
+
+    return index;
+}
+
+// Adds an fd that yields struct input_event records and returns its index.
+// capabilities is only used when fd is not an evdev node. The fd is made
+// nonblocking and is closed by Input_Destroy.
+int Input_AddFd(Input *input, int fd, const char *name, int capabilities)
+{
+    int index = Input_AddDevice(input, name, capabilities);
+    if (index < 0) return -1;
+
+    InputDevice *device = &input->devices[index];
+    struct input_absinfo info;
+
+    device->fd = fd;
+
+    int version;
+    device->evdev = ioctl(fd, EVIOCGVERSION, &version) == 0;
+    if (device->evdev) device->info.capabilities = Input_Capabilities(fd);
+
+    if (device->evdev) {
+        // Same clock as clock_gettime(CLOCK_MONOTONIC), so frame times can be compared with ours
+        int clock = CLOCK_MONOTONIC;
+        ioctl(fd, EVIOCSCLOCKID, &clock);
+
+        int code = device->info.capabilities & INPUT_TOUCH ? ABS_MT_POSITION_X : ABS_X;
+        if (ioctl(fd, EVIOCGABS(code), &info) == 0) device->info.axisX = (InputAxis) { info.minimum, info.maximum };
+        code = device->info.capabilities & INPUT_TOUCH ? ABS_MT_POSITION_Y : ABS_Y;
+        if (ioctl(fd, EVIOCGABS(code), &info) == 0) device->info.axisY = (InputAxis) { info.minimum, info.maximum };
+
+        Input_Resync(device);
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event event = { .events = EPOLLIN, .data.u32 = index };
+    if (epoll_ctl(input->epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+        input->count--;
+        return -1;
+    }
+
+    return index;
+}
+
+// Opens every /dev/input/event* node reporting any of the wanted
+// capabilities, returns how many were added
+int Input_OpenDevices(Input *input, int wanted)
+{
+    DIR *dir = opendir("/dev/input");
+    struct dirent *entry;
+    int added = 0;
+
+    if (!dir) return 0;
+
+    while ((entry = readdir(dir)) && input->count < INPUT_MAX_DEVICES) {
+        char path[280], name[64] = "";
+
+        if (strncmp(entry->d_name, "event", 5) != 0) continue;
+        snprintf(path, sizeof(path), "/dev/input/%s", entry->d_name);
+
+        int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) continue;
+
+        if (!(Input_Capabilities(fd) & wanted)) {
+            close(fd);
+            continue;
+        }
+
+        ioctl(fd, EVIOCGNAME(sizeof(name)), name);
+        if (Input_AddFd(input, fd, name[0] ? name : path, 0) < 0) {
+            close(fd);
+            continue;
+        }
+        added++;
+    }
+
+    closedir(dir);
+
+    return added;
+}
+
+// Folds count events of one device into its state, calling handler for
+// every frame a SYN_REPORT completes. The tap, if any, gets each frame's
+// events after they are folded, and a frame left open at the end of events
+// once that much is. Returns the number of frames.
+int Input_Feed(Input *input, int index, const struct input_event *events, int count, InputHandler handler, void *user)
+{
+    InputDevice *device = &input->devices[index];
+    InputFrame *frame = &device->frame;
+    int frames = 0;
+    int tapped = 0;
+
+    for (int i = 0; i < count; i++) {
+        const struct input_event *ev = &events[i];
+
+        if (ev->type == EV_SYN) {
+            if (ev->code == SYN_DROPPED) {
+                // The frame so far is incomplete too, the resync restores the absolute state
+                device->dropping = 1;
+                frame->events = 0;
+                frame->dx = frame->dy = frame->wheel = 0;
+            } else if (ev->code == SYN_REPORT) {
+                if (device->dropping) {
+                    device->dropping = 0;
+                    Input_Resync(device);
+                    frame->changed |= INPUT_CHANGED_ABS | INPUT_CHANGED_TOUCH | INPUT_CHANGED_KEYS;
+                }
+
+                frame->timeUs = (uint64_t) ev->input_event_sec * 1000000 + ev->input_event_usec;
+                handler(frame, user);
+                frames++;
+
+                frame->changed = 0;
+                frame->events = 0;
+                frame->dx = frame->dy = frame->wheel = 0;
+
+                if (input->tap) input->tap(index, events + tapped, i + 1 - tapped, input->tapUser);
+                tapped = i + 1;
+            }
+            continue;
+        }
+
+        if (device->dropping) continue;
+        frame->events++;
+
+        switch (ev->type) {
+        case EV_REL:
+            frame->changed |= INPUT_CHANGED_REL;
+            if (ev->code == REL_X) frame->dx += ev->value;
+            else if (ev->code == REL_Y) frame->dy += ev->value;
+            else if (ev->code == REL_WHEEL) frame->wheel += ev->value;
+            break;
+
+        case EV_ABS:
+            if (ev->code == ABS_MT_SLOT) {
+                device->slot = ev->value >= 0 && ev->value < INPUT_MAX_SLOTS ? ev->value : -1;
+            } else if (ev->code > ABS_MT_SLOT) {
+                // Slots past INPUT_MAX_SLOTS are not tracked, their events are dropped
+                if (device->slot < 0) break;
+
+                InputSlot *slot = &frame->slots[device->slot];
+
+                frame->changed |= INPUT_CHANGED_TOUCH;
+                switch (ev->code) {
+                case ABS_MT_TRACKING_ID:
+                    frame->touches += (ev->value >= 0) - slot->active;
+                    slot->active = ev->value >= 0;
+                    slot->trackingId = ev->value;
+                    break;
+                case ABS_MT_POSITION_X: slot->x = ev->value; break;
+                case ABS_MT_POSITION_Y: slot->y = ev->value; break;
+                case ABS_MT_PRESSURE: slot->pressure = ev->value; break;
+                }
+            } else {
+                frame->changed |= INPUT_CHANGED_ABS;
+                if (ev->code == ABS_X) frame->x = ev->value;
+                else if (ev->code == ABS_Y) frame->y = ev->value;
+                else if (ev->code == ABS_PRESSURE) frame->pressure = ev->value;
+            }
+            break;
+
+        case EV_KEY:
+            if (ev->code < KEY_CNT) {
+                frame->changed |= INPUT_CHANGED_KEYS;
+                if (ev->value) frame->keys[ev->code / 8] |= 1 << (ev->code % 8);
+                else frame->keys[ev->code / 8] &= ~(1 << (ev->code % 8));
+            }
+            break;
+        }
+    }
+
+    if (input->tap && tapped < count) input->tap(index, events + tapped, count - tapped, input->tapUser);
+
+    return frames;
+}
+
+// Drains everything readable on one device. A device that went away is
+// dropped from the epoll set and its fd closed.
+int Input_Read(Input *input, int index, InputHandler handler, void *user)
+{
+    InputDevice *device = &input->devices[index];
+    struct input_event events[INPUT_READ_EVENTS];
+    int frames = 0;
+
+    for (;;) {
+        // evdev always returns whole records, a pipe may split one
+        memcpy(events, device->partial, device->partialBytes);
+        ssize_t bytes = read(device->fd, (uint8_t *) events + device->partialBytes, sizeof(events) - device->partialBytes);
+
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0 && errno == EAGAIN) break;
+        if (bytes <= 0) {
+            epoll_ctl(input->epoll, EPOLL_CTL_DEL, device->fd, NULL);
+            close(device->fd);
+            device->fd = -1;
+            break;
+        }
+
+        size_t total = device->partialBytes + bytes;
+        int count = total / sizeof(struct input_event);
+
+        device->partialBytes = total % sizeof(struct input_event);
+        memcpy(device->partial, &events[count], device->partialBytes);
+
+        frames += Input_Feed(input, index, events, count, handler, user);
+        if (total < sizeof(events)) break;
+    }
+
+    return frames;
+}
+
+// Waits up to timeoutMs (-1 forever) for input and handles all of it,
+// returns the number of frames delivered or -1 on error
+int Input_Poll(Input *input, int timeoutMs, InputHandler handler, void *user)
+{
+    struct epoll_event ready[INPUT_MAX_DEVICES];
+    int frames = 0;
+
+    int n = epoll_wait(input->epoll, ready, INPUT_MAX_DEVICES, timeoutMs);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+
+    for (int i = 0; i < n; i++) {
+        frames += Input_Read(input, ready[i].data.u32, handler, user);
+    }
+
+    return frames;
+}
+
+// Devices that are still open
+int Input_Open(const Input *input)
+{
+    int count = 0;
+
+    for (int i = 0; i < input->count; i++) count += input->devices[i].fd >= 0;
+
+    return count;
+}
+
+void Input_Destroy(Input *input)
+{
+    for (int i = 0; i < input->count; i++) {
+        if (input->devices[i].fd >= 0) close(input->devices[i].fd);
+    }
+    close(input->epoll);
+    input->count = 0;
+}
+
+#endif
@@ -0,0 +1,379 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include "input.h"
+
+// Binary input traces, so interactive paths can be benchmarked without
+// anyone touching a device. A trace starts with a header and a table of the
+// devices recorded, followed by one record per SYN_REPORT frame:
+//
+//   InputTraceHeader  "ITR1", device count, start time in microseconds
+//   InputTraceDevice  name, INPUT_* capabilities and axis ranges, per device
+//   InputTraceFrame   microseconds since the previous frame, device, event count
+//   InputTraceEvent   type, code, value, count times
+//
+// The SYN_REPORT itself is implied, so an event takes 8 bytes instead of
+// the 24 of struct input_event. Everything is little endian, as written.
+// Each device's first frame restates what it held when recording began:
+// absolute position, keys down and touching slots, so a replay starts from
+// the same state as the recording did.
+//
+// The writer is an InputTap, installed on a live Input it records exactly
+// what the devices delivered. Like Input_Feed it leaves out a frame cut
+// short by SYN_DROPPED, and writes the difference between the state the
+// resync read back and the state a replay would be in by then instead. Replay either goes through Input_Feed in the
+// same process, or writes input_event records into fds, which may be pipes
+// added with Input_AddFd or uinput devices, so the epoll path runs as well.
+
+#define INPUT_TRACE_MAGIC "ITR1"
+#define INPUT_TRACE_FRAME_EVENTS 256    // Longest frame kept, further events are dropped
+
+typedef struct {
+    char magic[4];
+    uint32_t devices;
+    uint64_t startUs;           // CLOCK_MONOTONIC when recording began
+} InputTraceHeader;
+
+typedef struct {
+    char name[64];
+    int32_t capabilities;
+    int32_t axisX[2], axisY[2]; // min, max
+} InputTraceDevice;
+
+typedef struct {
+    uint32_t deltaUs;
+    uint16_t device;
+    uint16_t count;
+} InputTraceFrame;
+
+typedef struct {
+    uint16_t type, code;
+    int32_t value;
+} InputTraceEvent;
+
+static inline uint64_t inputTraceNowUs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+typedef struct {
+    FILE *file;
+    uint64_t lastUs;
+    long frames;
+    long events;
+    long dropped;               // Events past INPUT_TRACE_FRAME_EVENTS or cut off by SYN_DROPPED
+    const Input *input;         // The live devices, for their state at the start and after a resync
+    Input replayed;             // What a replay of the trace so far holds, the frames are fed to it
+    int dropping[INPUT_MAX_DEVICES];
+    int pending[INPUT_MAX_DEVICES];
+    InputTraceEvent buffer[INPUT_MAX_DEVICES][INPUT_TRACE_FRAME_EVENTS];
+} InputTraceWriter;
+
+static void inputTraceIgnore(const InputFrame *frame, void *user)
+{
+}
+
+// Writes the pending events of device as one frame ending at timeUs
+static void inputTraceWriteFrame(InputTraceWriter *writer, int device, uint64_t timeUs)
+{
+    InputTraceFrame frame = {
+        .deltaUs = timeUs > writer->lastUs ? timeUs - writer->lastUs : 0,
+        .device = device,
+        .count = writer->pending[device]
+    };
+
+    fwrite(&frame, sizeof(frame), 1, writer->file);
+    fwrite(writer->buffer[device], sizeof(InputTraceEvent), frame.count, writer->file);
+    if (timeUs > writer->lastUs) writer->lastUs = timeUs;
+    writer->frames++;
+    writer->events += frame.count;
+    writer->pending[device] = 0;
+
+    struct input_event events[INPUT_TRACE_FRAME_EVENTS + 1] = { 0 };
+    for (int i = 0; i < frame.count; i++) {
+        events[i].type = writer->buffer[device][i].type;
+        events[i].code = writer->buffer[device][i].code;
+        events[i].value = writer->buffer[device][i].value;
+    }
+    events[frame.count].type = EV_SYN;
+    events[frame.count].code = SYN_REPORT;
+    Input_Feed(&writer->replayed, device, events, frame.count + 1, inputTraceIgnore, NULL);
+}
+
+static void inputTracePend(InputTraceWriter *writer, int device, int type, int code, int value)
+{
+    if (writer->pending[device] < INPUT_TRACE_FRAME_EVENTS) {
+        writer->buffer[device][writer->pending[device]++] = (InputTraceEvent) { type, code, value };
+    } else {
+        writer->dropped++;
+    }
+}
+
+// Pends what a replay of device needs to reach the live state, only what
+// differs, so nothing when they agree
+static void inputTracePendState(InputTraceWriter *writer, int index)
+{
+    const InputDevice *live = &writer->input->devices[index];
+    const InputDevice *replayed = &writer->replayed.devices[index];
+    const InputFrame *frame = &live->frame, *was = &replayed->frame;
+
+    if (frame->x != was->x) inputTracePend(writer, index, EV_ABS, ABS_X, frame->x);
+    if (frame->y != was->y) inputTracePend(writer, index, EV_ABS, ABS_Y, frame->y);
+    if (frame->pressure != was->pressure) inputTracePend(writer, index, EV_ABS, ABS_PRESSURE, frame->pressure);
+
+    int selected = 0;
+    for (int s = 0; s < INPUT_MAX_SLOTS; s++) {
+        const InputSlot *slot = &frame->slots[s];
+        if (memcmp(slot, &was->slots[s], sizeof(InputSlot)) == 0) continue;
+
+        inputTracePend(writer, index, EV_ABS, ABS_MT_SLOT, s);
+        inputTracePend(writer, index, EV_ABS, ABS_MT_TRACKING_ID, slot->trackingId);
+        inputTracePend(writer, index, EV_ABS, ABS_MT_POSITION_X, slot->x);
+        inputTracePend(writer, index, EV_ABS, ABS_MT_POSITION_Y, slot->y);
+        inputTracePend(writer, index, EV_ABS, ABS_MT_PRESSURE, slot->pressure);
+        selected = 1;
+    }
+    // Later events address whichever slot the device was on
+    if (selected || live->slot != replayed->slot) inputTracePend(writer, index, EV_ABS, ABS_MT_SLOT, live->slot);
+
+    for (int key = 0; key < KEY_CNT; key++) {
+        int down = INPUT_BIT(frame->keys, key);
+        if (down != INPUT_BIT(was->keys, key)) inputTracePend(writer, index, EV_KEY, key, down);
+    }
+}
+
+// Starts a trace of every device in input, beginning with the state each is in
+int InputTraceWriter_Open(InputTraceWriter *writer, const char *path, const Input *input)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        perror(path);
+        return -1;
+    }
+
+    InputTraceHeader header = { .devices = input->count, .startUs = inputTraceNowUs() };
+    memcpy(header.magic, INPUT_TRACE_MAGIC, 4);
+    fwrite(&header, sizeof(header), 1, writer->file);
+    writer->lastUs = header.startUs;
+    writer->input = input;
+
+    for (int i = 0; i < input->count; i++) {
+        const InputDeviceInfo *info = &input->devices[i].info;
+        InputTraceDevice device = {
+            .capabilities = info->capabilities,
+            .axisX = { info->axisX.min, info->axisX.max },
+            .axisY = { info->axisY.min, info->axisY.max }
+        };
+
+        snprintf(device.name, sizeof(device.name), "%s", info->name);
+        fwrite(&device, sizeof(device), 1, writer->file);
+        Input_AddDevice(&writer->replayed, info->name, info->capabilities);
+    }
+
+    for (int i = 0; i < input->count; i++) {
+        inputTracePendState(writer, i);
+        if (writer->pending[i] > 0) inputTraceWriteFrame(writer, i, writer->lastUs);
+    }
+
+    return 0;
+}
+
+// An InputTap, install with input->tap = InputTraceWriter_Tap, input->tapUser = writer
+void InputTraceWriter_Tap(int device, const struct input_event *events, int count, void *user)
+{
+    InputTraceWriter *writer = user;
+
+    for (int i = 0; i < count; i++) {
+        const struct input_event *ev = &events[i];
+
+        if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+            writer->dropped += writer->pending[device];
+            writer->pending[device] = 0;
+            writer->dropping[device] = 1;
+        } else if (ev->type == EV_SYN && ev->code == SYN_REPORT) {
+            // Taps run after Input_Feed, so a device that dropped events is resynced by now
+            if (writer->dropping[device]) inputTracePendState(writer, device);
+            writer->dropping[device] = 0;
+            inputTraceWriteFrame(writer, device, (uint64_t) ev->input_event_sec * 1000000 + ev->input_event_usec);
+        } else if (writer->dropping[device]) {
+            writer->dropped++;
+        } else {
+            inputTracePend(writer, device, ev->type, ev->code, ev->value);
+        }
+    }
+}
+
+int InputTraceWriter_Close(InputTraceWriter *writer)
+{
+    return fclose(writer->file) == 0 ? 0 : -1;
+}
+
+typedef struct {
+    FILE *file;
+    InputTraceHeader header;
+    InputTraceDevice devices[INPUT_MAX_DEVICES];
+    uint64_t timeUs;            // Recorded time of the last frame read
+} InputTraceReader;
+
+int InputTraceReader_Open(InputTraceReader *reader, const char *path)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->file = fopen(path, "rb");
+    if (!reader->file) {
+        perror(path);
+        return -1;
+    }
+
+    if (fread(&reader->header, sizeof(reader->header), 1, reader->file) != 1
+        || memcmp(reader->header.magic, INPUT_TRACE_MAGIC, 4) != 0 || reader->header.devices > INPUT_MAX_DEVICES
+        || fread(reader->devices, sizeof(InputTraceDevice), reader->header.devices, reader->file) != reader->header.devices) {
+        fprintf(stderr, "%s is not an input trace\n", path);
+        fclose(reader->file);
+        return -1;
+    }
+    reader->timeUs = reader->header.startUs;
+
+    return 0;
+}
+
+void InputTraceReader_Rewind(InputTraceReader *reader)
+{
+    fseek(reader->file, sizeof(InputTraceHeader) + reader->header.devices * sizeof(InputTraceDevice), SEEK_SET);
+    reader->timeUs = reader->header.startUs;
+}
+
+// Reads the next frame into events, SYN_REPORT included and stamped with the
+// recorded time. events needs room for INPUT_TRACE_FRAME_EVENTS + 1. Returns
+// the number of events, 0 at the end of the trace or -1 when it is damaged.
+int InputTraceReader_Next(InputTraceReader *reader, int *device, struct input_event *events)
+{
+    InputTraceFrame frame;
+    InputTraceEvent stored[INPUT_TRACE_FRAME_EVENTS];
+
+    if (fread(&frame, sizeof(frame), 1, reader->file) != 1) return 0;
+    if (frame.device >= reader->header.devices || frame.count > INPUT_TRACE_FRAME_EVENTS
+        || fread(stored, sizeof(InputTraceEvent), frame.count, reader->file) != frame.count) {
+        return -1;
+    }
+
+    reader->timeUs += frame.deltaUs;
+    *device = frame.device;
+
+    struct input_event ev = { 0 };
+    ev.input_event_sec = reader->timeUs / 1000000;
+    ev.input_event_usec = reader->timeUs % 1000000;
+
+    for (int i = 0; i < frame.count; i++) {
+        ev.type = stored[i].type;
+        ev.code = stored[i].code;
+        ev.value = stored[i].value;
+        events[i] = ev;
+    }
+    ev.type = EV_SYN;
+    ev.code = SYN_REPORT;
+    ev.value = 0;
+    events[frame.count] = ev;
+
+    return frame.count + 1;
+}
+
+void InputTraceReader_Close(InputTraceReader *reader)
+{
+    fclose(reader->file);
+}
+
+// Adds the recorded devices to input as fd-less devices, returns the index of the first
+int InputTrace_AddDevices(const InputTraceReader *reader, Input *input)
+{
+    int first = input->count;
+
+    for (uint32_t i = 0; i < reader->header.devices; i++) {
+        const InputTraceDevice *recorded = &reader->devices[i];
+        int index = Input_AddDevice(input, recorded->name, recorded->capabilities);
+        if (index < 0) return -1;
+
+        input->devices[index].info.axisX = (InputAxis) { recorded->axisX[0], recorded->axisX[1] };
+        input->devices[index].info.axisY = (InputAxis) { recorded->axisY[0], recorded->axisY[1] };
+    }
+
+    return first;
+}
+
+// Sleeps until the frame at recorded time timeUs is due, returns the replay
+// time it was due at. start holds the replay and recorded start times.
+static uint64_t inputTraceWait(const uint64_t start[2], uint64_t timeUs)
+{
+    uint64_t due = start[0] + (timeUs - start[1]);
+    struct timespec at = { .tv_sec = due / 1000000, .tv_nsec = due % 1000000 * 1000 };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) != 0) {}
+
+    return due;
+}
+
+static void inputTraceStamp(struct input_event *events, int count, uint64_t timeUs)
+{
+    for (int i = 0; i < count; i++) {
+        events[i].input_event_sec = timeUs / 1000000;
+        events[i].input_event_usec = timeUs % 1000000;
+    }
+}
+
+// Feeds the rest of the trace through Input_Feed to the devices that
+// InputTrace_AddDevices returned first for. With realtime set the frames are
+// spaced as recorded and stamped with the replay clock, otherwise they go
+// through back to back with the recorded stamps. Returns the frame count.
+long InputTrace_Replay(InputTraceReader *reader, Input *input, int first, int realtime, InputHandler handler, void *user)
+{
+    struct input_event events[INPUT_TRACE_FRAME_EVENTS + 1];
+    uint64_t start[2] = { inputTraceNowUs(), 0 };
+    long frames = 0;
+    int device, count;
+
+    while ((count = InputTraceReader_Next(reader, &device, events)) > 0) {
+        if (realtime) {
+            if (frames == 0) start[1] = reader->timeUs;
+            inputTraceStamp(events, count, inputTraceWait(start, reader->timeUs));
+        }
+        frames += Input_Feed(input, first + device, events, count, handler, user);
+    }
+
+    return count < 0 ? -1 : frames;
+}
+
+// Writes the rest of the trace as input_event records, frame by frame, to
+// fds[device]. Devices without an fd (-1) are skipped. Pacing and stamps are
+// as for InputTrace_Replay. Returns the frame count.
+long InputTrace_ReplayToFds(InputTraceReader *reader, const int *fds, int realtime)
+{
+    struct input_event events[INPUT_TRACE_FRAME_EVENTS + 1];
+    uint64_t start[2] = { inputTraceNowUs(), 0 };
+    long frames = 0;
+    int device, count;
+
+    while ((count = InputTraceReader_Next(reader, &device, events)) > 0) {
+        if (realtime) {
+            if (frames == 0) start[1] = reader->timeUs;
+            inputTraceStamp(events, count, inputTraceWait(start, reader->timeUs));
+        }
+        if (fds[device] < 0) continue;
+
+        ssize_t bytes = count * sizeof(struct input_event);
+        if (write(fds[device], events, bytes) != bytes) return -1;
+        frames++;
+    }
+
+    return count < 0 ? -1 : frames;
+}
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include "tga.h"
+#include "wavefront_obj.h"
+#include "render.h"
+#include "arena.h"
+#include "profile.h"
+
+// Instanced drawing: one indexed mesh, many placements. The mesh keeps
+// pointing at the model's vertex and face arrays, and each instance adds
+// only a transform and a color, so memory grows per unique mesh rather
+// than per copy.
+//
+// drawInstanced culls instances whose bounding sphere is off screen and
+// then works through the rest in batches. Worker threads transform the
+// vertices of a batch into screen space, then the calling thread draws
+// the batch in instance order, so overlapping instances always come out
+// the same. Screen space scratch is sized per batch, not per instance.
+
+typedef struct {
+    float m[16];                // Row major, transforms column vectors: p' = M p
+} Mat4;
+
+typedef struct {
+    Mat4 transform;
+    TGAPixel color;
+} Instance;
+
+typedef struct {
+    Vertex3D *vertices;         // Shared with the OBJ_Model, not copied
+    size_t vertexCount;
+    Face32 *faces;
+    size_t faceCount;
+    Vertex3D center;            // Bounding sphere in model space
+    float radius;
+} IndexedMesh;
+
+typedef struct {
+    int x, y;
+} ScreenPoint;
+
+#define INSTANCE_BATCH 256
+#define INSTANCE_MAX_THREADS 64
+
+Mat4 Mat4_Identity()
+{
+    return (Mat4) { { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } };
+}
+
+Mat4 Mat4_Multiply(Mat4 a, Mat4 b)
+{
+    Mat4 r;
+
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) {
+            r.m[row * 4 + col] = a.m[row * 4 + 0] * b.m[0 * 4 + col] + a.m[row * 4 + 1] * b.m[1 * 4 + col]
+                               + a.m[row * 4 + 2] * b.m[2 * 4 + col] + a.m[row * 4 + 3] * b.m[3 * 4 + col];
+        }
+    }
+
+    return r;
+}
+
+Mat4 Mat4_Translate(float x, float y, float z)
+{
+    Mat4 r = Mat4_Identity();
+    r.m[3] = x;
+    r.m[7] = y;
+    r.m[11] = z;
+
+    return r;
+}
+
+Mat4 Mat4_Scale(float s)
+{
+    Mat4 r = Mat4_Identity();
+    r.m[0] = r.m[5] = r.m[10] = s;
+
+    return r;
+}
+
+// Around the vertical axis, same direction as drawMeshRotated
+Mat4 Mat4_RotateY(float angle)
+{
+    Mat4 r = Mat4_Identity();
+    float c = cosf(angle);
+    float s = sinf(angle);
+
+    r.m[0] = c;
+    r.m[2] = s;
+    r.m[8] = -s;
+    r.m[10] = c;
+
+    return r;
+}
+
+Mat4 Mat4_RotateX(float angle)
+{
+    Mat4 r = Mat4_Identity();
+    float c = cosf(angle);
+    float s = sinf(angle);
+
+    r.m[5] = c;
+    r.m[6] = -s;
+    r.m[9] = s;
+    r.m[10] = c;
+
+    return r;
+}
+
+static inline Vertex3D Mat4_Apply(const Mat4 *t, Vertex3D v)
+{
+    const float *m = t->m;
+
+    return (Vertex3D) {
+        m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3],
+        m[4] * v.x + m[5] * v.y + m[6] * v.z + m[7],
+        m[8] * v.x + m[9] * v.y + m[10] * v.z + m[11]
+    };
+}
+
+IndexedMesh IndexedMesh_FromModel(OBJ_Model *model)
+{
+    IndexedMesh mesh = {
+        .vertices = model->vertexData,
+        .vertexCount = model->vertexSize,
+        .faces = model->faceData,
+        .faceCount = model->faceSize
+    };
+
+    if (mesh.vertexCount == 0) return mesh;
+
+    Vertex3D lo = mesh.vertices[0], hi = mesh.vertices[0];
+    for (size_t i = 1; i < mesh.vertexCount; i++) {
+        Vertex3D v = mesh.vertices[i];
+        lo.x = fminf(lo.x, v.x); lo.y = fminf(lo.y, v.y); lo.z = fminf(lo.z, v.z);
+        hi.x = fmaxf(hi.x, v.x); hi.y = fmaxf(hi.y, v.y); hi.z = fmaxf(hi.z, v.z);
+    }
+
+    mesh.center = (Vertex3D) { (lo.x + hi.x) / 2, (lo.y + hi.y) / 2, (lo.z + hi.z) / 2 };
+
+    for (size_t i = 0; i < mesh.vertexCount; i++) {
+        float dx = mesh.vertices[i].x - mesh.center.x;
+        float dy = mesh.vertices[i].y - mesh.center.y;
+        float dz = mesh.vertices[i].z - mesh.center.z;
+        float d = sqrtf(dx * dx + dy * dy + dz * dz);
+        if (d > mesh.radius) mesh.radius = d;
+    }
+
+    return mesh;
+}
+
+// Whether the transformed bounding sphere reaches the [-1, 1] square that projectX/Y map to the image
+int Instance_Visible(const IndexedMesh *mesh, const Instance *instance)
+{
+    const float *m = instance->transform.m;
+    Vertex3D c = Mat4_Apply(&instance->transform, mesh->center);
+
+    // The largest axis scale bounds how far the sphere can stretch
+    float sx = m[0] * m[0] + m[4] * m[4] + m[8] * m[8];
+    float sy = m[1] * m[1] + m[5] * m[5] + m[9] * m[9];
+    float sz = m[2] * m[2] + m[6] * m[6] + m[10] * m[10];
+    float r = mesh->radius * sqrtf(fmaxf(sx, fmaxf(sy, sz)));
+
+    return c.x + r >= -1 && c.x - r <= 1 && c.y + r >= -1 && c.y - r <= 1;
+}
+
+typedef struct {
+    const IndexedMesh *mesh;
+    const Instance *instances;
+    const int *visible;         // Indices of the instances that survived culling
+    int visibleCount;
+    ScreenPoint *points;        // INSTANCE_BATCH * vertexCount
+    int width, height;
+    int threads;
+    int batchStart;
+    int stopping;
+    pthread_barrier_t start, done;
+} InstanceBatch;
+
+typedef struct {
+    InstanceBatch *batch;
+    int thread;
+} InstanceWorker;
+
+// Transforms this thread's share of the current batch
+void InstanceBatch_Transform(InstanceBatch *batch, int thread)
+{
+    PROFILE_SCOPE("transform");
+    const IndexedMesh *mesh = batch->mesh;
+    int count = batch->visibleCount - batch->batchStart;
+    if (count > INSTANCE_BATCH) count = INSTANCE_BATCH;
+
+    for (int i = thread; i < count; i += batch->threads) {
+        const Instance *instance = &batch->instances[batch->visible[batch->batchStart + i]];
+        ScreenPoint *out = batch->points + (size_t) i * mesh->vertexCount;
+
+        for (size_t v = 0; v < mesh->vertexCount; v++) {
+            Vertex3D p = Mat4_Apply(&instance->transform, mesh->vertices[v]);
+            out[v] = (ScreenPoint) { projectX(p.x, batch->width), projectY(p.y, batch->height) };
+        }
+    }
+}
+
+void* InstanceBatch_Worker(void *arg)
+{
+    InstanceWorker *worker = arg;
+    InstanceBatch *batch = worker->batch;
+
+    for (;;) {
+        pthread_barrier_wait(&batch->start);
+        if (batch->stopping) break;
+        InstanceBatch_Transform(batch, worker->thread);
+        pthread_barrier_wait(&batch->done);
+    }
+
+    return NULL;
+}
+
+// Draws count instances of mesh as wireframes, transforming with threads
+// threads. Scratch comes from arena and is released again before returning.
+// Returns the number of instances drawn after culling.
+int drawInstanced(const IndexedMesh *mesh, const Instance *instances, int count, TGAImage *image,
+                  int threads, Arena *arena)
+{
+    size_t mark = Arena_Mark(arena);
+    InstanceBatch batch = {
+        .mesh = mesh,
+        .instances = instances,
+        .width = image->header.width,
+        .height = image->header.height,
+        .threads = threads < 1 ? 1 : threads > INSTANCE_MAX_THREADS ? INSTANCE_MAX_THREADS : threads
+    };
+    int *visible = ARENA_NEW(arena, int, count);
+    batch.points = ARENA_NEW(arena, ScreenPoint, (size_t) INSTANCE_BATCH * mesh->vertexCount);
+    if (!visible || !batch.points) {
+        Arena_Release(arena, mark);
+        return 0;
+    }
+
+    {
+        PROFILE_SCOPE("cull");
+
+        for (int i = 0; i < count; i++) {
+            if (Instance_Visible(mesh, &instances[i])) visible[batch.visibleCount++] = i;
+        }
+        batch.visible = visible;
+
+        PROFILE_COUNT(PROFILE_TRIANGLES_IN, (int64_t) count * mesh->faceCount);
+        PROFILE_COUNT(PROFILE_TRIANGLES_CULLED, (int64_t) (count - batch.visibleCount) * mesh->faceCount);
+    }
+
+    // The calling thread is worker 0
+    pthread_t workers[INSTANCE_MAX_THREADS];
+    InstanceWorker args[INSTANCE_MAX_THREADS];
+    if (batch.threads > 1) {
+        pthread_barrier_init(&batch.start, NULL, batch.threads);
+        pthread_barrier_init(&batch.done, NULL, batch.threads);
+        for (int t = 1; t < batch.threads; t++) {
+            args[t] = (InstanceWorker) { &batch, t };
+            pthread_create(&workers[t], NULL, InstanceBatch_Worker, &args[t]);
+        }
+    }
+
+    for (batch.batchStart = 0; batch.batchStart < batch.visibleCount; batch.batchStart += INSTANCE_BATCH) {
+        if (batch.threads > 1) pthread_barrier_wait(&batch.start);
+        InstanceBatch_Transform(&batch, 0);
+        if (batch.threads > 1) pthread_barrier_wait(&batch.done);
+
+        PROFILE_SCOPE("raster");
+        int n = batch.visibleCount - batch.batchStart;
+        if (n > INSTANCE_BATCH) n = INSTANCE_BATCH;
+
+        for (int i = 0; i < n; i++) {
+            const ScreenPoint *p = batch.points + (size_t) i * mesh->vertexCount;
+            TGAPixel color = instances[visible[batch.batchStart + i]].color;
+
+            for (size_t f = 0; f < mesh->faceCount; f++) {
+                const Face32 *face = &mesh->faces[f];
+
+                drawLine(p[face->v0].x, p[face->v0].y, p[face->v1].x, p[face->v1].y, image, color);
+                drawLine(p[face->v1].x, p[face->v1].y, p[face->v2].x, p[face->v2].y, image, color);
+                drawLine(p[face->v2].x, p[face->v2].y, p[face->v0].x, p[face->v0].y, image, color);
+            }
+        }
+    }
+
+    if (batch.threads > 1) {
+        batch.stopping = 1;
+        pthread_barrier_wait(&batch.start);
+        for (int t = 1; t < batch.threads; t++) {
+            pthread_join(workers[t], NULL);
+        }
+        pthread_barrier_destroy(&batch.start);
+        pthread_barrier_destroy(&batch.done);
+    }
+
+    Arena_Release(arena, mark);
+
+    return batch.visibleCount;
+}
+
+#endif
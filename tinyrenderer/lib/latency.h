@@ -0,0 +1,221 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Input to photon latency. Every input frame is stamped by the kernel and
+// followed through the stages of the render frame that consumed it:
+//
+//   queue    kernel timestamp to the program reading it
+//   wait     read to the start of the frame that uses it
+//   update   simulation and state changes
+//   render   drawing into the back buffer
+//   present  buffer submitted to the flip completing, the photon part
+//   total    kernel timestamp to flip completion
+//
+// All times are CLOCK_MONOTONIC microseconds, the clock evdev (see
+// Input_AddFd) and DRM flip events use. Samples go into log-linear
+// histograms, accurate to about 3%, that report p50, p99 and the maximum.
+//
+//   Latency_Input(tracker, frame->timeUs);           as each input frame is read
+//   int token = Latency_BeginFrame(tracker);         inputs so far belong to this frame
+//   Latency_Mark(tracker, token, LATENCY_UPDATE);    end of update
+//   Latency_Mark(tracker, token, LATENCY_RENDER);    end of render, buffer submitted
+//   Latency_Presented(tracker, token, flipUs);       flip done, samples recorded
+//
+// Several frames may be in flight, the tokens tell them apart.
+
+#define LATENCY_EXACT 64                    // Below this every microsecond has its own bucket
+#define LATENCY_SUB_BUCKETS 32              // Per power of two above it
+#define LATENCY_BUCKETS (LATENCY_EXACT + 21 * LATENCY_SUB_BUCKETS)     // Up to about 67 s
+#define LATENCY_FRAME_INPUTS 64             // Inputs kept per frame, the rest are only counted
+#define LATENCY_MAX_FRAMES 8                // Frames in flight
+
+typedef enum {
+    LATENCY_QUEUE,
+    LATENCY_WAIT,
+    LATENCY_UPDATE,
+    LATENCY_RENDER,
+    LATENCY_PRESENT,
+    LATENCY_TOTAL,
+    LATENCY_STAGES
+} LatencyStage;
+
+const char *latencyStageNames[LATENCY_STAGES] = { "queue", "wait", "update", "render", "present", "total" };
+
+typedef struct {
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t samples;
+    uint64_t max;
+} LatencyHistogram;
+
+typedef struct {
+    uint64_t inputUs, readUs;
+} LatencyInput;
+
+typedef struct {
+    int active;
+    uint64_t stageUs[LATENCY_STAGES];       // When each stage started
+    int inputCount;
+    LatencyInput inputs[LATENCY_FRAME_INPUTS];
+} LatencyFrame;
+
+typedef struct {
+    int pendingCount;                       // Inputs read since the last frame began
+    LatencyInput pending[LATENCY_FRAME_INPUTS];
+    LatencyFrame frames[LATENCY_MAX_FRAMES];
+    int next;
+    uint64_t frameCount;
+    uint64_t inputFrames;                   // Frames that carried at least one input
+    uint64_t untracked;                     // Inputs over LATENCY_FRAME_INPUTS, or no free frame
+    LatencyHistogram stages[LATENCY_STAGES];
+} LatencyTracker;
+
+static inline uint64_t latencyNowUs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static inline int latencyBucket(uint64_t us)
+{
+    if (us < LATENCY_EXACT) return us;
+
+    int exponent = 63 - __builtin_clzll(us);
+    int bucket = LATENCY_EXACT + (exponent - 6) * LATENCY_SUB_BUCKETS + (int) ((us >> (exponent - 5)) & 31);
+
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// Smallest value that lands in bucket
+static inline uint64_t latencyBucketValue(int bucket)
+{
+    if (bucket < LATENCY_EXACT) return bucket;
+
+    int exponent = (bucket - LATENCY_EXACT) / LATENCY_SUB_BUCKETS + 6;
+    uint64_t sub = (bucket - LATENCY_EXACT) % LATENCY_SUB_BUCKETS;
+
+    return (1ull << exponent) + (sub << (exponent - 5));
+}
+
+// Time from start to end, 0 when replayed or skewed stamps put end first
+static inline uint64_t latencySpan(uint64_t start, uint64_t end)
+{
+    return end > start ? end - start : 0;
+}
+
+void LatencyHistogram_Add(LatencyHistogram *histogram, uint64_t us)
+{
+    histogram->counts[latencyBucket(us)]++;
+    histogram->samples++;
+    if (us > histogram->max) histogram->max = us;
+}
+
+// Value at or below which percentile percent of the samples fall
+uint64_t LatencyHistogram_Percentile(const LatencyHistogram *histogram, double percentile)
+{
+    uint64_t rank = (uint64_t) (histogram->samples * percentile / 100 + 0.5);
+    uint64_t seen = 0;
+
+    if (rank == 0) rank = 1;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += histogram->counts[b];
+        if (seen >= rank) return latencyBucketValue(b);
+    }
+
+    return histogram->max;
+}
+
+void Latency_Init(LatencyTracker *tracker)
+{
+    memset(tracker, 0, sizeof(*tracker));
+}
+
+// An input frame with kernel timestamp inputUs has just been read
+void Latency_Input(LatencyTracker *tracker, uint64_t inputUs)
+{
+    if (tracker->pendingCount == LATENCY_FRAME_INPUTS) {
+        tracker->untracked++;
+        return;
+    }
+
+    tracker->pending[tracker->pendingCount++] = (LatencyInput) { inputUs, latencyNowUs() };
+}
+
+// Starts a frame carrying every input read since the last one, returns its token or -1
+int Latency_BeginFrame(LatencyTracker *tracker)
+{
+    int token = tracker->next;
+    LatencyFrame *frame = &tracker->frames[token];
+
+    if (frame->active) {
+        tracker->untracked += tracker->pendingCount;
+        tracker->pendingCount = 0;
+        return -1;
+    }
+
+    frame->active = 1;
+    frame->stageUs[LATENCY_UPDATE] = latencyNowUs();
+    frame->inputCount = tracker->pendingCount;
+    memcpy(frame->inputs, tracker->pending, tracker->pendingCount * sizeof(LatencyInput));
+    tracker->pendingCount = 0;
+    tracker->next = (token + 1) % LATENCY_MAX_FRAMES;
+
+    return token;
+}
+
+// stage has finished, LATENCY_UPDATE or LATENCY_RENDER
+void Latency_Mark(LatencyTracker *tracker, int token, LatencyStage stage)
+{
+    if (token < 0) return;
+
+    tracker->frames[token].stageUs[stage + 1] = latencyNowUs();
+}
+
+// The frame reached the screen at presentUs, records a sample per input it carried
+void Latency_Presented(LatencyTracker *tracker, int token, uint64_t presentUs)
+{
+    if (token < 0) return;
+
+    LatencyFrame *frame = &tracker->frames[token];
+    uint64_t *at = frame->stageUs;
+
+    for (int i = 0; i < frame->inputCount; i++) {
+        LatencyInput *input = &frame->inputs[i];
+
+        LatencyHistogram_Add(&tracker->stages[LATENCY_QUEUE], latencySpan(input->inputUs, input->readUs));
+        LatencyHistogram_Add(&tracker->stages[LATENCY_WAIT], latencySpan(input->readUs, at[LATENCY_UPDATE]));
+        LatencyHistogram_Add(&tracker->stages[LATENCY_UPDATE], latencySpan(at[LATENCY_UPDATE], at[LATENCY_RENDER]));
+        LatencyHistogram_Add(&tracker->stages[LATENCY_RENDER], latencySpan(at[LATENCY_RENDER], at[LATENCY_PRESENT]));
+        LatencyHistogram_Add(&tracker->stages[LATENCY_PRESENT], latencySpan(at[LATENCY_PRESENT], presentUs));
+        LatencyHistogram_Add(&tracker->stages[LATENCY_TOTAL], latencySpan(input->inputUs, presentUs));
+    }
+
+    tracker->frameCount++;
+    tracker->inputFrames += frame->inputCount > 0;
+    frame->active = 0;
+}
+
+void Latency_Print(const LatencyTracker *tracker, FILE *file)
+{
+    const LatencyHistogram *total = &tracker->stages[LATENCY_TOTAL];
+
+    fprintf(file, "%llu frames presented, %llu with input, %llu input samples, %llu untracked\n",
+            (unsigned long long) tracker->frameCount, (unsigned long long) tracker->inputFrames,
+            (unsigned long long) total->samples, (unsigned long long) tracker->untracked);
+    fprintf(file, "%-8s %10s %10s %10s\n", "stage", "p50 us", "p99 us", "max us");
+
+    for (int s = 0; s < LATENCY_STAGES; s++) {
+        const LatencyHistogram *h = &tracker->stages[s];
+        fprintf(file, "%-8s %10llu %10llu %10llu\n", latencyStageNames[s],
+                (unsigned long long) LatencyHistogram_Percentile(h, 50),
+                (unsigned long long) LatencyHistogram_Percentile(h, 99), (unsigned long long) h->max);
+    }
+}
+
+#endif
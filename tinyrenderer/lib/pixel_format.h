@@ -0,0 +1,407 @@
+#ifndef PIXEL_FORMAT_H
+#define PIXEL_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXEL_FORMAT_X86
+#endif
+
+// Conversion kernels between the pixel layouts used by the outputs:
+//   BGR24     TGAPixel, bytes B, G, R
+//   XRGB8888  DRM dumb buffers and 24/32 bit X11 visuals, 0x00RRGGBB words
+//   RGB565    16 bit visuals, RRRRRGGG GGGBBBBB words
+// Every kernel has a scalar reference plus SSSE3 and AVX2 versions, the best
+// one the CPU supports is picked at runtime on first use.
+
+typedef enum {
+    PIXEL_BGR24,
+    PIXEL_XRGB8888,
+    PIXEL_RGB565,
+    PIXEL_FORMATS
+} PixelFormat;
+
+typedef enum {
+    PIXEL_ISA_SCALAR,
+    PIXEL_ISA_SSSE3,
+    PIXEL_ISA_AVX2,
+    PIXEL_ISAS
+} PixelIsa;
+
+typedef void (*PixelConvertFn)(const void *src, void *dst, size_t count);
+
+const char *pixelFormatNames[PIXEL_FORMATS] = { "BGR24", "XRGB8888", "RGB565" };
+const char *pixelIsaNames[PIXEL_ISAS] = { "scalar", "ssse3", "avx2" };
+const int pixelFormatBytes[PIXEL_FORMATS] = { 3, 4, 2 };
+
+// Scalar reference
+
+void pixelBGR24ToXRGB8888Scalar(const void *src, void *dst, size_t count)
+{
+    const uint8_t *s = src;
+    uint32_t *d = dst;
+
+    for (size_t i = 0; i < count; i++) {
+        d[i] = (s[3*i + 2] << 16) | (s[3*i + 1] << 8) | s[3*i];
+    }
+}
+
+void pixelXRGB8888ToBGR24Scalar(const void *src, void *dst, size_t count)
+{
+    const uint32_t *s = src;
+    uint8_t *d = dst;
+
+    for (size_t i = 0; i < count; i++) {
+        d[3*i] = s[i];
+        d[3*i + 1] = s[i] >> 8;
+        d[3*i + 2] = s[i] >> 16;
+    }
+}
+
+void pixelXRGB8888ToRGB565Scalar(const void *src, void *dst, size_t count)
+{
+    const uint32_t *s = src;
+    uint16_t *d = dst;
+
+    for (size_t i = 0; i < count; i++) {
+        d[i] = ((s[i] >> 8) & 0xF800) | ((s[i] >> 5) & 0x07E0) | ((s[i] >> 3) & 0x001F);
+    }
+}
+
+void pixelRGB565ToXRGB8888Scalar(const void *src, void *dst, size_t count)
+{
+    const uint16_t *s = src;
+    uint32_t *d = dst;
+
+    for (size_t i = 0; i < count; i++) {
+        // Replicate the top bits into the low ones so 0x1F maps to 0xFF
+        uint32_t r = (s[i] >> 11) & 0x1F;
+        uint32_t g = (s[i] >> 5) & 0x3F;
+        uint32_t b = s[i] & 0x1F;
+        d[i] = (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+    }
+}
+
+void pixelBGR24ToRGB565Scalar(const void *src, void *dst, size_t count)
+{
+    const uint8_t *s = src;
+    uint16_t *d = dst;
+
+    for (size_t i = 0; i < count; i++) {
+        d[i] = ((s[3*i + 2] & 0xF8) << 8) | ((s[3*i + 1] & 0xFC) << 3) | (s[3*i] >> 3);
+    }
+}
+
+void pixelRGB565ToBGR24Scalar(const void *src, void *dst, size_t count)
+{
+    const uint16_t *s = src;
+    uint8_t *d = dst;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t r = (s[i] >> 11) & 0x1F;
+        uint32_t g = (s[i] >> 5) & 0x3F;
+        uint32_t b = s[i] & 0x1F;
+        d[3*i] = (b << 3) | (b >> 2);
+        d[3*i + 1] = (g << 2) | (g >> 4);
+        d[3*i + 2] = (r << 3) | (r >> 2);
+    }
+}
+
+#ifdef PIXEL_FORMAT_X86
+
+// SSSE3: pshufb moves the 3 byte pixels in and out of 32 bit lanes
+
+__attribute__((target("ssse3")))
+void pixelBGR24ToXRGB8888SSSE3(const void *src, void *dst, size_t count)
+{
+    const uint8_t *s = src;
+    uint32_t *d = dst;
+    const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (s + 3*i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (s + 3*i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (s + 3*i + 32));
+
+        _mm_storeu_si128((__m128i *) (d + i), _mm_shuffle_epi8(a, expand));
+        _mm_storeu_si128((__m128i *) (d + i + 4), _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), expand));
+        _mm_storeu_si128((__m128i *) (d + i + 8), _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), expand));
+        _mm_storeu_si128((__m128i *) (d + i + 12), _mm_shuffle_epi8(_mm_srli_si128(c, 4), expand));
+    }
+
+    pixelBGR24ToXRGB8888Scalar(s + 3*i, d + i, count - i);
+}
+
+__attribute__((target("ssse3")))
+void pixelXRGB8888ToBGR24SSSE3(const void *src, void *dst, size_t count)
+{
+    const uint32_t *s = src;
+    uint8_t *d = dst;
+    const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i p0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + i)), pack);
+        __m128i p1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + i + 4)), pack);
+        __m128i p2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + i + 8)), pack);
+        __m128i p3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + i + 12)), pack);
+
+        _mm_storeu_si128((__m128i *) (d + 3*i), _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+        _mm_storeu_si128((__m128i *) (d + 3*i + 16), _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8)));
+        _mm_storeu_si128((__m128i *) (d + 3*i + 32), _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4)));
+    }
+
+    pixelXRGB8888ToBGR24Scalar(s + i, d + 3*i, count - i);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i pixelPack565SSSE3(__m128i p)
+{
+    __m128i r = _mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xF800));
+    __m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07E0));
+    __m128i b = _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001F));
+
+    return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+__attribute__((target("ssse3")))
+void pixelXRGB8888ToRGB565SSSE3(const void *src, void *dst, size_t count)
+{
+    const uint32_t *s = src;
+    uint16_t *d = dst;
+    const __m128i low = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_shuffle_epi8(pixelPack565SSSE3(_mm_loadu_si128((const __m128i *) (s + i))), low);
+        __m128i b = _mm_shuffle_epi8(pixelPack565SSSE3(_mm_loadu_si128((const __m128i *) (s + i + 4))), low);
+
+        _mm_storeu_si128((__m128i *) (d + i), _mm_unpacklo_epi64(a, b));
+    }
+
+    pixelXRGB8888ToRGB565Scalar(s + i, d + i, count - i);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i pixelExpand565SSSE3(__m128i p)
+{
+    __m128i r = _mm_and_si128(_mm_srli_epi32(p, 11), _mm_set1_epi32(0x1F));
+    __m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x3F));
+    __m128i b = _mm_and_si128(p, _mm_set1_epi32(0x1F));
+
+    r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+    g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 4));
+    b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(g, 8)), b);
+}
+
+__attribute__((target("ssse3")))
+void pixelRGB565ToXRGB8888SSSE3(const void *src, void *dst, size_t count)
+{
+    const uint16_t *s = src;
+    uint32_t *d = dst;
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i p = _mm_loadu_si128((const __m128i *) (s + i));
+
+        _mm_storeu_si128((__m128i *) (d + i), pixelExpand565SSSE3(_mm_unpacklo_epi16(p, zero)));
+        _mm_storeu_si128((__m128i *) (d + i + 4), pixelExpand565SSSE3(_mm_unpackhi_epi16(p, zero)));
+    }
+
+    pixelRGB565ToXRGB8888Scalar(s + i, d + i, count - i);
+}
+
+// AVX2: the 3 byte side is split across the two 128 bit lanes with vpermd
+// so that each lane can use the same pshufb pattern as the SSSE3 version
+
+__attribute__((target("avx2")))
+void pixelBGR24ToXRGB8888AVX2(const void *src, void *dst, size_t count)
+{
+    const uint8_t *s = src;
+    uint32_t *d = dst;
+    const __m256i spread = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+    const __m256i expand = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    size_t i = 0;
+
+    // Each 32 byte load only uses 24 bytes, stop early enough not to read past the end
+    for (; i + 16 + 3 <= count; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (s + 3*i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (s + 3*i + 24));
+
+        a = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(a, spread), expand);
+        b = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(b, spread), expand);
+
+        _mm256_storeu_si256((__m256i *) (d + i), a);
+        _mm256_storeu_si256((__m256i *) (d + i + 8), b);
+    }
+
+    pixelBGR24ToXRGB8888SSSE3(s + 3*i, d + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void pixelXRGB8888ToBGR24AVX2(const void *src, void *dst, size_t count)
+{
+    const uint32_t *s = src;
+    uint8_t *d = dst;
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    size_t i = 0;
+
+    // The last 8 bytes of every 32 byte store are overwritten by the next one
+    for (; i + 8 + 3 <= count; i += 8) {
+        __m256i p = _mm256_loadu_si256((const __m256i *) (s + i));
+
+        p = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(p, pack), gather);
+        _mm256_storeu_si256((__m256i *) (d + 3*i), p);
+    }
+
+    pixelXRGB8888ToBGR24SSSE3(s + i, d + 3*i, count - i);
+}
+
+__attribute__((target("avx2")))
+void pixelXRGB8888ToRGB565AVX2(const void *src, void *dst, size_t count)
+{
+    const uint32_t *s = src;
+    uint16_t *d = dst;
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (s + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (s + i + 8));
+
+        a = _mm256_or_si256(_mm256_or_si256(
+                _mm256_and_si256(_mm256_srli_epi32(a, 8), _mm256_set1_epi32(0xF800)),
+                _mm256_and_si256(_mm256_srli_epi32(a, 5), _mm256_set1_epi32(0x07E0))),
+                _mm256_and_si256(_mm256_srli_epi32(a, 3), _mm256_set1_epi32(0x001F)));
+        b = _mm256_or_si256(_mm256_or_si256(
+                _mm256_and_si256(_mm256_srli_epi32(b, 8), _mm256_set1_epi32(0xF800)),
+                _mm256_and_si256(_mm256_srli_epi32(b, 5), _mm256_set1_epi32(0x07E0))),
+                _mm256_and_si256(_mm256_srli_epi32(b, 3), _mm256_set1_epi32(0x001F)));
+
+        // packus works per lane, restore pixel order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *) (d + i), packed);
+    }
+
+    pixelXRGB8888ToRGB565SSSE3(s + i, d + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void pixelRGB565ToXRGB8888AVX2(const void *src, void *dst, size_t count)
+{
+    const uint16_t *s = src;
+    uint32_t *d = dst;
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i p = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (s + i)));
+
+        __m256i r = _mm256_and_si256(_mm256_srli_epi32(p, 11), _mm256_set1_epi32(0x1F));
+        __m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x3F));
+        __m256i b = _mm256_and_si256(p, _mm256_set1_epi32(0x1F));
+
+        r = _mm256_or_si256(_mm256_slli_epi32(r, 3), _mm256_srli_epi32(r, 2));
+        g = _mm256_or_si256(_mm256_slli_epi32(g, 2), _mm256_srli_epi32(g, 4));
+        b = _mm256_or_si256(_mm256_slli_epi32(b, 3), _mm256_srli_epi32(b, 2));
+
+        p = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 16), _mm256_slli_epi32(g, 8)), b);
+        _mm256_storeu_si256((__m256i *) (d + i), p);
+    }
+
+    pixelRGB565ToXRGB8888SSSE3(s + i, d + i, count - i);
+}
+
+#endif
+
+// BGR24 <-> RGB565 goes through XRGB8888 in small blocks that stay in L1
+
+#define PIXEL_CHAIN_BLOCK 256
+
+#define PIXEL_CHAIN(name, first, second, srcBytes, dstBytes)                    \
+    void name(const void *src, void *dst, size_t count)                        \
+    {                                                                           \
+        uint32_t block[PIXEL_CHAIN_BLOCK];                                      \
+        for (size_t i = 0; i < count; i += PIXEL_CHAIN_BLOCK) {                 \
+            size_t n = count - i < PIXEL_CHAIN_BLOCK ? count - i : PIXEL_CHAIN_BLOCK; \
+            first((const uint8_t *) src + i * srcBytes, block, n);              \
+            second(block, (uint8_t *) dst + i * dstBytes, n);                   \
+        }                                                                       \
+    }
+
+#ifdef PIXEL_FORMAT_X86
+PIXEL_CHAIN(pixelBGR24ToRGB565SSSE3, pixelBGR24ToXRGB8888SSSE3, pixelXRGB8888ToRGB565SSSE3, 3, 2)
+PIXEL_CHAIN(pixelRGB565ToBGR24SSSE3, pixelRGB565ToXRGB8888SSSE3, pixelXRGB8888ToBGR24SSSE3, 2, 3)
+PIXEL_CHAIN(pixelBGR24ToRGB565AVX2, pixelBGR24ToXRGB8888AVX2, pixelXRGB8888ToRGB565AVX2, 3, 2)
+PIXEL_CHAIN(pixelRGB565ToBGR24AVX2, pixelRGB565ToXRGB8888AVX2, pixelXRGB8888ToBGR24AVX2, 2, 3)
+#endif
+
+// Kernels indexed by [isa][from][to], NULL where from == to or the ISA is not built
+PixelConvertFn pixelKernels[PIXEL_ISAS][PIXEL_FORMATS][PIXEL_FORMATS] = {
+    [PIXEL_ISA_SCALAR] = {
+        [PIXEL_BGR24] = { [PIXEL_XRGB8888] = pixelBGR24ToXRGB8888Scalar, [PIXEL_RGB565] = pixelBGR24ToRGB565Scalar },
+        [PIXEL_XRGB8888] = { [PIXEL_BGR24] = pixelXRGB8888ToBGR24Scalar, [PIXEL_RGB565] = pixelXRGB8888ToRGB565Scalar },
+        [PIXEL_RGB565] = { [PIXEL_BGR24] = pixelRGB565ToBGR24Scalar, [PIXEL_XRGB8888] = pixelRGB565ToXRGB8888Scalar },
+    },
+#ifdef PIXEL_FORMAT_X86
+    [PIXEL_ISA_SSSE3] = {
+        [PIXEL_BGR24] = { [PIXEL_XRGB8888] = pixelBGR24ToXRGB8888SSSE3, [PIXEL_RGB565] = pixelBGR24ToRGB565SSSE3 },
+        [PIXEL_XRGB8888] = { [PIXEL_BGR24] = pixelXRGB8888ToBGR24SSSE3, [PIXEL_RGB565] = pixelXRGB8888ToRGB565SSSE3 },
+        [PIXEL_RGB565] = { [PIXEL_BGR24] = pixelRGB565ToBGR24SSSE3, [PIXEL_XRGB8888] = pixelRGB565ToXRGB8888SSSE3 },
+    },
+    [PIXEL_ISA_AVX2] = {
+        [PIXEL_BGR24] = { [PIXEL_XRGB8888] = pixelBGR24ToXRGB8888AVX2, [PIXEL_RGB565] = pixelBGR24ToRGB565AVX2 },
+        [PIXEL_XRGB8888] = { [PIXEL_BGR24] = pixelXRGB8888ToBGR24AVX2, [PIXEL_RGB565] = pixelXRGB8888ToRGB565AVX2 },
+        [PIXEL_RGB565] = { [PIXEL_BGR24] = pixelRGB565ToBGR24AVX2, [PIXEL_XRGB8888] = pixelRGB565ToXRGB8888AVX2 },
+    },
+#endif
+};
+
+int pixelIsaSupported(PixelIsa isa)
+{
+    switch (isa) {
+        case PIXEL_ISA_SCALAR:
+            return 1;
+#ifdef PIXEL_FORMAT_X86
+        case PIXEL_ISA_SSSE3:
+            return __builtin_cpu_supports("ssse3");
+        case PIXEL_ISA_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return 0;
+    }
+}
+
+PixelIsa pixelBestIsa()
+{
+    static int best = -1;
+
+    if (best < 0) {
+        best = PIXEL_ISA_SCALAR;
+        if (pixelIsaSupported(PIXEL_ISA_SSSE3)) best = PIXEL_ISA_SSSE3;
+        if (pixelIsaSupported(PIXEL_ISA_AVX2)) best = PIXEL_ISA_AVX2;
+    }
+
+    return best;
+}
+
+// Converts count pixels with the fastest kernel for this CPU
+void pixelConvert(PixelFormat from, PixelFormat to, const void *src, void *dst, size_t count)
+{
+    if (from == to) {
+        memcpy(dst, src, count * pixelFormatBytes[from]);
+        return;
+    }
+
+    pixelKernels[pixelBestIsa()][from][to](src, dst, count);
+}
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+// Stage timers and counters that compile to nothing unless PROFILE is defined.
+//
+//   PROFILE_SCOPE("raster");            times the rest of the enclosing block
+//   PROFILE_COUNT(PROFILE_LINES, 1);    adds to a counter
+//   PROFILE_SAMPLE();                   records the counters since the last sample
+//   PROFILE_THREAD_NAME("writer");      labels the calling thread in the trace
+//   PROFILE_WRITE_TRACE("trace.json");  Chrome trace of everything recorded
+//   PROFILE_WRITE_WINDOW(path, from, to) only what overlaps [from, to] in PROFILE_NOW() time
+//
+// Every thread records into its own ring of events, so timing a scope takes
+// no lock. When a ring wraps the oldest events are overwritten. The ring of
+// a thread that exits goes to the next new thread, which carries on after its
+// events, so short lived workers cost no more rings than run at once. The JSON
+// opens in chrome://tracing or https://ui.perfetto.dev.
+
+typedef enum {
+    PROFILE_TRIANGLES_IN,
+    PROFILE_TRIANGLES_CULLED,
+    PROFILE_LINES,
+    PROFILE_PIXELS,
+    PROFILE_ALLOCATIONS,
+    PROFILE_COUNTERS
+} ProfileCounter;
+
+#ifdef PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define PROFILE_EVENTS_PER_THREAD (1 << 16)
+
+const char *profileCounterNames[PROFILE_COUNTERS] = {
+    "triangles in", "triangles culled", "lines drawn", "pixels written", "allocations"
+};
+
+typedef struct {
+    const char *name;
+    uint64_t start;             // ns since the profile epoch
+    uint64_t duration;
+    int64_t value;              // Counter samples only
+    int counter;                // -1 for a timed scope
+} ProfileEvent;
+
+typedef struct ProfileThread {
+    ProfileEvent events[PROFILE_EVENTS_PER_THREAD];
+    _Atomic uint64_t count;     // Events ever recorded, the ring holds the last ones
+    int tid;
+    int exited;                 // Free for the next new thread, under profileLock
+    char name[32];
+    struct ProfileThread *next;
+} ProfileThread;
+
+static __thread ProfileThread *profileThread;
+static pthread_key_t profileThreadKey;      // Its destructor hands the ring back
+ProfileThread *profileThreads;
+pthread_mutex_t profileLock = PTHREAD_MUTEX_INITIALIZER;
+int profileThreadCount;
+_Atomic int64_t profileCounters[PROFILE_COUNTERS];
+uint64_t profileEpoch;
+
+static inline uint64_t profileClockNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void profileThreadExit(void *ring)
+{
+    pthread_mutex_lock(&profileLock);
+    ((ProfileThread *) ring)->exited = 1;
+    pthread_mutex_unlock(&profileLock);
+}
+
+__attribute__((constructor)) static void profileStart()
+{
+    profileEpoch = profileClockNs();
+    pthread_key_create(&profileThreadKey, profileThreadExit);
+}
+
+static inline uint64_t Profile_Now()
+{
+    return profileClockNs() - profileEpoch;
+}
+
+ProfileThread* Profile_Thread()
+{
+    if (profileThread) return profileThread;
+
+    pthread_mutex_lock(&profileLock);
+    for (ProfileThread *ring = profileThreads; ring; ring = ring->next) {
+        if (ring->exited) {
+            profileThread = ring;
+            break;
+        }
+    }
+    if (profileThread) {
+        profileThread->exited = 0;
+    } else {
+        profileThread = calloc(1, sizeof(ProfileThread));
+        profileThread->tid = ++profileThreadCount;
+        profileThread->next = profileThreads;
+        profileThreads = profileThread;
+    }
+    snprintf(profileThread->name, sizeof(profileThread->name), "thread %d", profileThread->tid);
+    pthread_mutex_unlock(&profileLock);
+
+    pthread_setspecific(profileThreadKey, profileThread);
+
+    return profileThread;
+}
+
+void Profile_Record(const char *name, uint64_t start, uint64_t duration, int counter, int64_t value)
+{
+    ProfileThread *thread = Profile_Thread();
+    uint64_t n = atomic_load_explicit(&thread->count, memory_order_relaxed);
+
+    thread->events[n % PROFILE_EVENTS_PER_THREAD] = (ProfileEvent) { name, start, duration, value, counter };
+    atomic_store_explicit(&thread->count, n + 1, memory_order_release);
+}
+
+typedef struct {
+    const char *name;
+    uint64_t start;
+} ProfileScope;
+
+static inline void Profile_EndScope(ProfileScope *scope)
+{
+    Profile_Record(scope->name, scope->start, Profile_Now() - scope->start, -1, 0);
+}
+
+void Profile_Sample()
+{
+    uint64_t now = Profile_Now();
+
+    for (int i = 0; i < PROFILE_COUNTERS; i++) {
+        int64_t value = atomic_exchange_explicit(&profileCounters[i], 0, memory_order_relaxed);
+        Profile_Record(profileCounterNames[i], now, 0, i, value);
+    }
+}
+
+void Profile_ThreadName(const char *name)
+{
+    snprintf(Profile_Thread()->name, sizeof(profileThread->name), "%s", name);
+}
+
+// Writes the events overlapping [from, to] as Chrome trace JSON, returns 0 on success
+int Profile_WriteWindow(const char *path, uint64_t from, uint64_t to)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"tinyrenderer\"}}");
+
+    pthread_mutex_lock(&profileLock);
+
+    for (ProfileThread *thread = profileThreads; thread; thread = thread->next) {
+        uint64_t count = atomic_load_explicit(&thread->count, memory_order_acquire);
+        uint64_t first = count > PROFILE_EVENTS_PER_THREAD ? count - PROFILE_EVENTS_PER_THREAD : 0;
+
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                thread->tid, thread->name);
+
+        for (uint64_t n = first; n < count; n++) {
+            ProfileEvent *e = &thread->events[n % PROFILE_EVENTS_PER_THREAD];
+
+            if (e->start > to || e->start + e->duration < from) continue;
+
+            if (e->counter < 0) {
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        e->name, thread->tid, e->start / 1e3, e->duration / 1e3);
+            } else {
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                        e->name, thread->tid, e->start / 1e3, (long long) e->value);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&profileLock);
+
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) \
+    ProfileScope PROFILE_CONCAT(profileScope, __LINE__) __attribute__((cleanup(Profile_EndScope))) = { name, Profile_Now() }
+#define PROFILE_COUNT(counter, n) atomic_fetch_add_explicit(&profileCounters[counter], (n), memory_order_relaxed)
+#define PROFILE_SAMPLE() Profile_Sample()
+#define PROFILE_THREAD_NAME(name) Profile_ThreadName(name)
+#define PROFILE_NOW() Profile_Now()
+#define PROFILE_WRITE_TRACE(path) Profile_WriteWindow((path), 0, UINT64_MAX)
+#define PROFILE_WRITE_WINDOW(path, from, to) Profile_WriteWindow((path), (from), (to))
+
+#else
+
+#define PROFILE_SCOPE(name) ((void) 0)
+#define PROFILE_COUNT(counter, n) ((void) 0)
+#define PROFILE_SAMPLE() ((void) 0)
+#define PROFILE_THREAD_NAME(name) ((void) 0)
+#define PROFILE_NOW() ((uint64_t) 0)
+#define PROFILE_WRITE_TRACE(path) ((void) (path), 0)
+#define PROFILE_WRITE_WINDOW(path, from, to) ((void) (path), (void) (from), (void) (to), 0)
+
+#endif
+
+#endif
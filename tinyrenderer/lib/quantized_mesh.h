@@ -0,0 +1,229 @@
+#ifndef QUANTIZED_MESH_H
+#define QUANTIZED_MESH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "tga.h"
+#include "wavefront_obj.h"
+#include "render.h"
+#include "arena.h"
+#include "instance.h"
+#include "profile.h"
+
+// Compact in-memory meshes. Positions are stored as 16 bit fractions of the
+// mesh bounding box, one array per axis. Indices are 16 bit when the mesh has
+// at most 65536 vertices, otherwise delta coded in blocks of 16 faces: a byte
+// giving the delta width, the first index in full, then 47 zigzag deltas of
+// 1, 2 or 4 bytes each. Vertex data is about half the float size, and
+// indices are half of it or less.
+//
+// Nothing is decoded up front. QuantizedMesh_Transform dequantizes inside
+// the transform, four vertices per step with SSE2, and the raster loop
+// unpacks one index block at a time.
+
+#define QMESH_BLOCK_FACES 16
+#define QMESH_BLOCK_INDICES (QMESH_BLOCK_FACES * 3)
+#define QMESH_BLOCK_BYTES (1 + 4 + (QMESH_BLOCK_INDICES - 1) * 4)  // Worst case
+#define QMESH_FORCE_DELTA 1     // Delta code indices even for small meshes, for testing
+
+typedef struct {
+    uint16_t *x, *y, *z;        // Padded to a multiple of 4 vertices
+    size_t vertexCount;
+    Vertex3D offset;            // Position = offset + q * scale
+    Vertex3D scale;
+    size_t faceCount;
+    uint16_t *indices16;        // 3 per face, NULL when delta coded
+    uint8_t *deltaStream;
+    uint32_t *blockOffsets;     // Start of each block in deltaStream
+    size_t bytes;               // Memory used by the arrays above
+} QuantizedMesh;
+
+static inline uint32_t qmeshZigzag(int32_t v) { return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31); }
+static inline int32_t qmeshUnzigzag(uint32_t v) { return (int32_t) (v >> 1) ^ -(int32_t) (v & 1); }
+
+// Builds the compact form of model in arena, flags may hold QMESH_FORCE_DELTA
+int QuantizedMesh_FromModel(QuantizedMesh *mesh, OBJ_Model *model, Arena *arena, int flags)
+{
+    size_t padded = (model->vertexSize + 3) & ~(size_t) 3;
+
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->vertexCount = model->vertexSize;
+    mesh->faceCount = model->faceSize;
+    mesh->x = ARENA_NEW_ZERO(arena, uint16_t, padded);
+    mesh->y = ARENA_NEW_ZERO(arena, uint16_t, padded);
+    mesh->z = ARENA_NEW_ZERO(arena, uint16_t, padded);
+    if (!mesh->x || !mesh->y || !mesh->z) return -1;
+    mesh->bytes = 3 * padded * sizeof(uint16_t);
+
+    if (mesh->vertexCount > 0) {
+        Vertex3D lo = model->vertexData[0], hi = model->vertexData[0];
+        for (size_t i = 1; i < mesh->vertexCount; i++) {
+            Vertex3D v = model->vertexData[i];
+            lo.x = fminf(lo.x, v.x); lo.y = fminf(lo.y, v.y); lo.z = fminf(lo.z, v.z);
+            hi.x = fmaxf(hi.x, v.x); hi.y = fmaxf(hi.y, v.y); hi.z = fmaxf(hi.z, v.z);
+        }
+
+        mesh->offset = lo;
+        mesh->scale = (Vertex3D) { (hi.x - lo.x) / 65535, (hi.y - lo.y) / 65535, (hi.z - lo.z) / 65535 };
+
+        for (size_t i = 0; i < mesh->vertexCount; i++) {
+            Vertex3D v = model->vertexData[i];
+            mesh->x[i] = mesh->scale.x > 0 ? lrintf((v.x - lo.x) / mesh->scale.x) : 0;
+            mesh->y[i] = mesh->scale.y > 0 ? lrintf((v.y - lo.y) / mesh->scale.y) : 0;
+            mesh->z[i] = mesh->scale.z > 0 ? lrintf((v.z - lo.z) / mesh->scale.z) : 0;
+        }
+    }
+
+    uint32_t *indices = (uint32_t *) model->faceData;
+    size_t indexCount = mesh->faceCount * 3;
+
+    if (mesh->vertexCount <= 65536 && !(flags & QMESH_FORCE_DELTA)) {
+        mesh->indices16 = ARENA_NEW(arena, uint16_t, indexCount);
+        if (!mesh->indices16) return -1;
+        for (size_t i = 0; i < indexCount; i++) mesh->indices16[i] = indices[i];
+        mesh->bytes += indexCount * sizeof(uint16_t);
+        return 0;
+    }
+
+    size_t blocks = (mesh->faceCount + QMESH_BLOCK_FACES - 1) / QMESH_BLOCK_FACES;
+    mesh->blockOffsets = ARENA_NEW(arena, uint32_t, blocks);
+    mesh->deltaStream = ARENA_NEW(arena, uint8_t, blocks * QMESH_BLOCK_BYTES);
+    if (!mesh->blockOffsets || !mesh->deltaStream) return -1;
+
+    size_t at = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        size_t first = b * QMESH_BLOCK_INDICES;
+        size_t count = indexCount - first < QMESH_BLOCK_INDICES ? indexCount - first : QMESH_BLOCK_INDICES;
+        uint32_t widest = 0;
+
+        for (size_t i = 1; i < count; i++) {
+            uint32_t d = qmeshZigzag((int32_t) (indices[first + i] - indices[first + i - 1]));
+            if (d > widest) widest = d;
+        }
+        uint8_t width = widest < 0x100 ? 1 : widest < 0x10000 ? 2 : 4;
+
+        mesh->blockOffsets[b] = at;
+        mesh->deltaStream[at++] = width;
+        memcpy(mesh->deltaStream + at, &indices[first], 4);
+        at += 4;
+
+        for (size_t i = 1; i < count; i++) {
+            uint32_t d = qmeshZigzag((int32_t) (indices[first + i] - indices[first + i - 1]));
+            memcpy(mesh->deltaStream + at, &d, width);  // Little endian, the low bytes come first
+            at += width;
+        }
+    }
+
+    // Give back the worst case space the blocks did not need
+    Arena_Release(arena, Arena_Mark(arena) - (blocks * QMESH_BLOCK_BYTES - at));
+    mesh->bytes += blocks * sizeof(uint32_t) + at;
+
+    return 0;
+}
+
+// Unpacks the indices of block b into out, returns how many there are
+int QuantizedMesh_DecodeBlock(const QuantizedMesh *mesh, size_t b, uint32_t out[QMESH_BLOCK_INDICES])
+{
+    size_t first = b * QMESH_BLOCK_INDICES;
+    int count = mesh->faceCount * 3 - first < QMESH_BLOCK_INDICES ? mesh->faceCount * 3 - first : QMESH_BLOCK_INDICES;
+
+    if (mesh->indices16) {
+        for (int i = 0; i < count; i++) out[i] = mesh->indices16[first + i];
+        return count;
+    }
+
+    const uint8_t *p = mesh->deltaStream + mesh->blockOffsets[b];
+    uint8_t width = *p++;
+
+    memcpy(&out[0], p, 4);
+    p += 4;
+
+    for (int i = 1; i < count; i++, p += width) {
+        uint32_t d = width == 1 ? p[0] : width == 2 ? (uint32_t) (p[0] | p[1] << 8) : (uint32_t) (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24);
+        out[i] = out[i - 1] + qmeshUnzigzag(d);
+    }
+
+    return count;
+}
+
+// Dequantizes, transforms and projects every vertex into out, which needs
+// room for the vertex count rounded up to a multiple of 4. The bounding box
+// scale, the matrix and the viewport are folded into one affine map per axis.
+void QuantizedMesh_Transform(const QuantizedMesh *mesh, const Mat4 *transform, int width, int height, ScreenPoint *out)
+{
+    PROFILE_SCOPE("transform");
+    const float *m = transform->m;
+    Vertex3D s = mesh->scale, o = mesh->offset;
+    float hx = (width - 1) / 2.0f;
+    float hy = (height - 1) / 2.0f;
+
+    // screen x = hx * (row0 . p + 1), screen y = hy * (1 - row1 . p)
+    float ax = hx * m[0] * s.x, bx = hx * m[1] * s.y, cx = hx * m[2] * s.z;
+    float dx = hx * (m[0] * o.x + m[1] * o.y + m[2] * o.z + m[3] + 1);
+    float ay = -hy * m[4] * s.x, by = -hy * m[5] * s.y, cy = -hy * m[6] * s.z;
+    float dy = hy * (1 - (m[4] * o.x + m[5] * o.y + m[6] * o.z + m[7]));
+    size_t i = 0;
+
+#ifdef __SSE2__
+    __m128 vax = _mm_set1_ps(ax), vbx = _mm_set1_ps(bx), vcx = _mm_set1_ps(cx), vdx = _mm_set1_ps(dx);
+    __m128 vay = _mm_set1_ps(ay), vby = _mm_set1_ps(by), vcy = _mm_set1_ps(cy), vdy = _mm_set1_ps(dy);
+    __m128i zero = _mm_setzero_si128();
+
+    for (; i < mesh->vertexCount; i += 4) {
+        __m128 qx = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (mesh->x + i)), zero));
+        __m128 qy = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (mesh->y + i)), zero));
+        __m128 qz = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (mesh->z + i)), zero));
+
+        __m128 sx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vax, qx), _mm_mul_ps(vbx, qy)), _mm_add_ps(_mm_mul_ps(vcx, qz), vdx));
+        __m128 sy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vay, qx), _mm_mul_ps(vby, qy)), _mm_add_ps(_mm_mul_ps(vcy, qz), vdy));
+
+        // Truncate like the int conversion in projectX/Y, then interleave into x, y pairs
+        __m128i ix = _mm_cvttps_epi32(sx);
+        __m128i iy = _mm_cvttps_epi32(sy);
+        _mm_storeu_si128((__m128i *) (out + i), _mm_unpacklo_epi32(ix, iy));
+        _mm_storeu_si128((__m128i *) (out + i + 2), _mm_unpackhi_epi32(ix, iy));
+    }
+#endif
+
+    for (; i < mesh->vertexCount; i++) {
+        float qx = mesh->x[i], qy = mesh->y[i], qz = mesh->z[i];
+
+        out[i].x = (ax * qx + bx * qy) + (cx * qz + dx);
+        out[i].y = (ay * qx + by * qy) + (cy * qz + dy);
+    }
+}
+
+// Draws the quantized mesh as a wireframe, screen points come from arena
+void drawQuantized(const QuantizedMesh *mesh, const Mat4 *transform, TGAImage *image, TGAPixel color, Arena *arena)
+{
+    size_t mark = Arena_Mark(arena);
+    ScreenPoint *p = ARENA_NEW(arena, ScreenPoint, (mesh->vertexCount + 3) & ~(size_t) 3);
+    uint32_t index[QMESH_BLOCK_INDICES];
+
+    if (!p) return;
+
+    QuantizedMesh_Transform(mesh, transform, image->header.width, image->header.height, p);
+
+    PROFILE_SCOPE("raster");
+    PROFILE_COUNT(PROFILE_TRIANGLES_IN, mesh->faceCount);
+
+    for (size_t b = 0; b * QMESH_BLOCK_FACES < mesh->faceCount; b++) {
+        int count = QuantizedMesh_DecodeBlock(mesh, b, index);
+
+        for (int i = 0; i + 2 < count; i += 3) {
+            ScreenPoint *v0 = &p[index[i]], *v1 = &p[index[i + 1]], *v2 = &p[index[i + 2]];
+
+            drawLine(v0->x, v0->y, v1->x, v1->y, image, color);
+            drawLine(v1->x, v1->y, v2->x, v2->y, image, color);
+            drawLine(v2->x, v2->y, v0->x, v0->y, image, color);
+        }
+    }
+
+    Arena_Release(arena, mark);
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdlib.h>
+#include <math.h>
+#include "tga.h"
+#include "wavefront_obj.h"
+#include "arena.h"
+#include "profile.h"
+
+void drawLine(int x0, int y0, int x1, int y1, TGAImage *image, TGAPixel color)
+{
+    // https://zingl.github.io/bresenham.html
+    int dx = abs(x1 - x0);
+    int sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0);
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;  // error value
+
+    PROFILE_COUNT(PROFILE_LINES, 1);
+    PROFILE_COUNT(PROFILE_PIXELS, (dx > -dy ? dx : -dy) + 1);
+
+    for (;;) {
+        tgaSetPixel(image, x0, y0, color);
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x0 += sx; }
+        if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+}
+
+void drawTriangle(Vertex3D v0, Vertex3D v1, Vertex3D v2, TGAImage *image, TGAPixel color)
+{
+    drawLine(v0.x, v0.y, v1.x, v1.y, image, color);
+    drawLine(v1.x, v1.y, v2.x, v2.y, image, color);
+    drawLine(v2.x, v2.y, v0.x, v0.y, image, color);
+}
+
+int projectX(float x, int width)
+{
+    int min_x, max_x;
+    float u;
+
+    min_x = -1;
+    max_x = 1;
+
+    u = (x - min_x) / (max_x - min_x);
+
+    return u * (width-1);
+}
+
+int projectY(float y, int height)
+{
+    int min_y, max_y;
+    float v;
+
+    min_y = -1;
+    max_y = 1;
+
+    v = (y - min_y) / (max_y - min_y);
+
+    return (1-v) * (height-1);
+}
+
+// Projects every triangle of the mesh onto the image and draws it as wireframe
+void drawMesh(Mesh *mesh, TGAImage *image, TGAPixel color)
+{
+    PROFILE_SCOPE("raster");
+    PROFILE_COUNT(PROFILE_TRIANGLES_IN, mesh->trisSize);
+
+    int width = image->header.width;
+    int height = image->header.height;
+
+    for (int i = 0; i < mesh->trisSize; i++) {
+        Triangle triangle = mesh->tris[i];
+
+        Vertex3D v0 = triangle.v0;
+        Vertex3D v1 = triangle.v1;
+        Vertex3D v2 = triangle.v2;
+
+        v0.x = projectX(v0.x, width);
+        v0.y = projectY(v0.y, height);
+        v1.x = projectX(v1.x, width);
+        v1.y = projectY(v1.y, height);
+        v2.x = projectX(v2.x, width);
+        v2.y = projectY(v2.y, height);
+
+        drawTriangle(v0, v1, v2, image, color);
+    }
+}
+
+// Same as drawMesh with the model turned around the vertical axis, for turntables
+void drawMeshRotated(Mesh *mesh, TGAImage *image, TGAPixel color, float angle)
+{
+    PROFILE_SCOPE("raster");
+    PROFILE_COUNT(PROFILE_TRIANGLES_IN, mesh->trisSize);
+
+    int width = image->header.width;
+    int height = image->header.height;
+    float c = cosf(angle);
+    float s = sinf(angle);
+
+    for (int i = 0; i < mesh->trisSize; i++) {
+        Triangle triangle = mesh->tris[i];
+
+        Vertex3D v0 = triangle.v0;
+        Vertex3D v1 = triangle.v1;
+        Vertex3D v2 = triangle.v2;
+
+        v0.x = projectX(c * triangle.v0.x + s * triangle.v0.z, width);
+        v0.y = projectY(v0.y, height);
+        v1.x = projectX(c * triangle.v1.x + s * triangle.v1.z, width);
+        v1.y = projectY(v1.y, height);
+        v2.x = projectX(c * triangle.v2.x + s * triangle.v2.z, width);
+        v2.y = projectY(v2.y, height);
+
+        drawTriangle(v0, v1, v2, image, color);
+    }
+}
+
+// Screen space triangle, what the transform stage hands to binning and raster
+typedef struct {
+    int x0, y0, x1, y1, x2, y2;
+} ScreenTriangle;
+
+// Transform stage of drawMeshRotated on its own, the output lives in the frame arena
+ScreenTriangle* transformMeshRotated(Mesh *mesh, int width, int height, float angle, Arena *arena)
+{
+    PROFILE_SCOPE("transform");
+    PROFILE_COUNT(PROFILE_TRIANGLES_IN, mesh->trisSize);
+
+    ScreenTriangle *out = ARENA_NEW(arena, ScreenTriangle, mesh->trisSize);
+    float c = cosf(angle);
+    float s = sinf(angle);
+
+    if (!out) return NULL;
+
+    for (int i = 0; i < mesh->trisSize; i++) {
+        Triangle *t = &mesh->tris[i];
+
+        out[i] = (ScreenTriangle) {
+            projectX(c * t->v0.x + s * t->v0.z, width), projectY(t->v0.y, height),
+            projectX(c * t->v1.x + s * t->v1.z, width), projectY(t->v1.y, height),
+            projectX(c * t->v2.x + s * t->v2.z, width), projectY(t->v2.y, height)
+        };
+    }
+
+    return out;
+}
+
+// Raster stage, draws the listed triangles shifted up by top rows
+void drawScreenTriangles(ScreenTriangle *tris, int *indices, int count, int top, TGAImage *image, TGAPixel color)
+{
+    PROFILE_SCOPE("raster");
+
+    for (int i = 0; i < count; i++) {
+        ScreenTriangle *p = &tris[indices ? indices[i] : i];
+
+        drawLine(p->x0, p->y0 - top, p->x1, p->y1 - top, image, color);
+        drawLine(p->x1, p->y1 - top, p->x2, p->y2 - top, image, color);
+        drawLine(p->x2, p->y2 - top, p->x0, p->y0 - top, image, color);
+    }
+}
+
+#endif
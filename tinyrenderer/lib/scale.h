@@ -0,0 +1,297 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Dynamic resolution: the frame is rasterized into a smaller internal
+// surface whose size is picked from the raster time of the previous frame,
+// then upscaled to the output. Both surfaces are XRGB8888.
+
+typedef struct {
+    double budgetMs;            // Raster time to aim for
+    float scale;                // Internal size as a fraction of the output, per axis
+    float minScale;
+    float maxScale;
+} DynamicResolution;
+
+void DynamicResolution_Init(DynamicResolution *dr, double budgetMs)
+{
+    dr->budgetMs = budgetMs;
+    dr->scale = 1.0f;
+    dr->minScale = 0.25f;
+    dr->maxScale = 1.0f;
+}
+
+// Raster cost grows with the pixel count, so with scale^2. Steer towards 90%
+// of the budget, moving half way per frame, and ignore changes below 2% so
+// the size does not flicker between neighbouring values.
+float DynamicResolution_Update(DynamicResolution *dr, double rasterMs)
+{
+    if (rasterMs <= 0) rasterMs = 0.001;
+
+    float ideal = dr->scale * sqrtf(0.9 * dr->budgetMs / rasterMs);
+    float next = dr->scale + (ideal - dr->scale) * 0.5f;
+
+    if (next < dr->minScale) next = dr->minScale;
+    if (next > dr->maxScale) next = dr->maxScale;
+
+    // Half resolution can use the exact 2x filter
+    if (fabsf(next - 0.5f) < 0.03f) next = 0.5f;
+
+    if (fabsf(next - dr->scale) >= 0.02f || next == 0.5f || next == dr->maxScale) {
+        dr->scale = next;
+    }
+
+    return dr->scale;
+}
+
+typedef struct {
+    int dstWidth;
+    int dstHeight;
+    int srcWidth;               // Source width the column tables were built for
+    int *xIndex;                // Left source column of every output column
+    uint16_t *xWeight;          // Weight of the right column, 0..256
+    uint16_t *xWeightPairs;     // Per column: left weight x4, right weight x4, ready for SIMD
+    uint32_t *rows[2];          // Horizontally scaled source rows
+    int rowY[2];                // Source row held by each cache slot
+} Upscaler;
+
+Upscaler* Upscaler_Create(int dstWidth, int dstHeight)
+{
+    Upscaler *upscaler = malloc(sizeof(Upscaler));
+
+    upscaler->dstWidth = dstWidth;
+    upscaler->dstHeight = dstHeight;
+    upscaler->srcWidth = 0;
+    upscaler->xIndex = malloc(dstWidth * sizeof(int));
+    upscaler->xWeight = malloc(dstWidth * sizeof(uint16_t));
+    upscaler->xWeightPairs = aligned_alloc(16, dstWidth * 8 * sizeof(uint16_t));
+    upscaler->rows[0] = malloc(dstWidth * sizeof(uint32_t));
+    upscaler->rows[1] = malloc(dstWidth * sizeof(uint32_t));
+
+    return upscaler;
+}
+
+void Upscaler_Destroy(Upscaler *upscaler)
+{
+    free(upscaler->xIndex);
+    free(upscaler->xWeight);
+    free(upscaler->xWeightPairs);
+    free(upscaler->rows[0]);
+    free(upscaler->rows[1]);
+    free(upscaler);
+}
+
+// Maps output coordinate to source in 16.16 fixed point, sampling pixel centres
+static inline int32_t Upscaler_SourceCoord(int dst, int srcSize, int dstSize)
+{
+    int32_t s = (int32_t) (((int64_t) (2 * dst + 1) * srcSize << 15) / dstSize) - (1 << 15);
+    return s < 0 ? 0 : s;
+}
+
+void Upscaler_BuildColumns(Upscaler *upscaler, int srcWidth)
+{
+    for (int x = 0; x < upscaler->dstWidth; x++) {
+        int32_t sx = Upscaler_SourceCoord(x, srcWidth, upscaler->dstWidth);
+        int x0 = sx >> 16;
+
+        // Past the last centre take the right pixel of the final pair in full,
+        // so every column reads two pixels inside the row
+        if (x0 >= srcWidth - 1) {
+            upscaler->xIndex[x] = srcWidth > 1 ? srcWidth - 2 : 0;
+            upscaler->xWeight[x] = srcWidth > 1 ? 256 : 0;
+        } else {
+            upscaler->xIndex[x] = x0;
+            upscaler->xWeight[x] = (sx & 0xFFFF) >> 8;
+        }
+
+        for (int c = 0; c < 4; c++) {
+            upscaler->xWeightPairs[8 * x + c] = 256 - upscaler->xWeight[x];
+            upscaler->xWeightPairs[8 * x + 4 + c] = upscaler->xWeight[x];
+        }
+    }
+
+    upscaler->srcWidth = srcWidth;
+    upscaler->rowY[0] = upscaler->rowY[1] = -1;
+}
+
+// Horizontal pass for one source row into a cached output-wide row
+void Upscaler_ScaleRow(Upscaler *upscaler, const uint32_t *src, uint32_t *dst)
+{
+    int x = 0;
+    int srcWidth = upscaler->srcWidth;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i *weights = (const __m128i *) upscaler->xWeightPairs;
+
+    // Two output pixels per step, each blends a pair of neighbouring source pixels
+    for (; srcWidth > 1 && x + 2 <= upscaler->dstWidth; x += 2) {
+        __m128i pair0 = _mm_loadl_epi64((const __m128i *) (src + upscaler->xIndex[x]));
+        __m128i pair1 = _mm_loadl_epi64((const __m128i *) (src + upscaler->xIndex[x + 1]));
+
+        pair0 = _mm_unpacklo_epi8(pair0, zero);
+        pair1 = _mm_unpacklo_epi8(pair1, zero);
+
+        pair0 = _mm_mullo_epi16(pair0, _mm_load_si128(weights + x));
+        pair1 = _mm_mullo_epi16(pair1, _mm_load_si128(weights + x + 1));
+
+        // Left pixel lives in the low half, right pixel in the high half
+        __m128i sum0 = _mm_srli_epi16(_mm_add_epi16(pair0, _mm_srli_si128(pair0, 8)), 8);
+        __m128i sum1 = _mm_srli_epi16(_mm_add_epi16(pair1, _mm_srli_si128(pair1, 8)), 8);
+
+        _mm_storel_epi64((__m128i *) (dst + x), _mm_packus_epi16(_mm_unpacklo_epi64(sum0, sum1), zero));
+    }
+#endif
+
+    for (; x < upscaler->dstWidth; x++) {
+        int i0 = upscaler->xIndex[x];
+        int i1 = i0 + 1 < srcWidth ? i0 + 1 : i0;
+        int w = upscaler->xWeight[x];
+        uint32_t out = 0;
+
+        for (int shift = 0; shift < 32; shift += 8) {
+            int a = (src[i0] >> shift) & 0xFF;
+            int b = (src[i1] >> shift) & 0xFF;
+            out |= ((a * (256 - w) + b * w) >> 8) << shift;
+        }
+        dst[x] = out;
+    }
+}
+
+// Vertical pass, blends two cached rows into an output row. The output is
+// not read again by us, so aligned rows are written with streaming stores
+// instead of pulling every destination line into the cache first.
+void Upscaler_BlendRows(const uint32_t *top, const uint32_t *bottom, uint32_t *dst, int width, int w)
+{
+    int x = 0;
+
+#ifdef __SSE2__
+    int aligned = ((uintptr_t) dst & 15) == 0;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wb = _mm_set1_epi16(w);
+    const __m128i wt = _mm_set1_epi16(256 - w);
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i t = _mm_loadu_si128((const __m128i *) (top + x));
+        __m128i b = _mm_loadu_si128((const __m128i *) (bottom + x));
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(t, zero), wt),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(t, zero), wt),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), wb));
+
+        __m128i out = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+        if (aligned) {
+            _mm_stream_si128((__m128i *) (dst + x), out);
+        } else {
+            _mm_storeu_si128((__m128i *) (dst + x), out);
+        }
+    }
+#endif
+
+    for (; x < width; x++) {
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int a = (top[x] >> shift) & 0xFF;
+            int b = (bottom[x] >> shift) & 0xFF;
+            out |= ((a * (256 - w) + b * w) >> 8) << shift;
+        }
+        dst[x] = out;
+    }
+}
+
+// Returns the cache slot holding source row y scaled horizontally
+uint32_t* Upscaler_Row(Upscaler *upscaler, const uint32_t *src, int srcStride, int y)
+{
+    if (upscaler->rowY[0] == y) return upscaler->rows[0];
+    if (upscaler->rowY[1] == y) return upscaler->rows[1];
+
+    // Rows are visited top to bottom, so the lower numbered slot is the stale one
+    int slot = upscaler->rowY[0] < upscaler->rowY[1] ? 0 : 1;
+    Upscaler_ScaleRow(upscaler, src + y * srcStride, upscaler->rows[slot]);
+    upscaler->rowY[slot] = y;
+
+    return upscaler->rows[slot];
+}
+
+// Bilinear upscale of a srcWidth x srcHeight XRGB8888 surface to the full output.
+// Strides are in pixels.
+void Upscaler_Bilinear(Upscaler *upscaler, const uint32_t *src, int srcWidth, int srcHeight, int srcStride,
+                       uint32_t *dst, int dstStride)
+{
+    if (upscaler->srcWidth != srcWidth) {
+        Upscaler_BuildColumns(upscaler, srcWidth);
+    }
+    upscaler->rowY[0] = upscaler->rowY[1] = -1;
+
+    for (int y = 0; y < upscaler->dstHeight; y++) {
+        int32_t sy = Upscaler_SourceCoord(y, srcHeight, upscaler->dstHeight);
+        int y0 = sy >> 16;
+        int w = (sy & 0xFFFF) >> 8;
+        int y1 = y0 + 1;
+
+        if (y0 >= srcHeight - 1) {
+            y0 = y1 = srcHeight - 1;
+            w = 0;
+        }
+
+        uint32_t *top = Upscaler_Row(upscaler, src, srcStride, y0);
+        uint32_t *bottom = w ? Upscaler_Row(upscaler, src, srcStride, y1) : top;
+
+        Upscaler_BlendRows(top, bottom, dst + y * dstStride, upscaler->dstWidth, w);
+    }
+
+#ifdef __SSE2__
+    _mm_sfence();
+#endif
+}
+
+// Exact 2x: every source pixel becomes a 2x2 block
+void Upscaler_Integer2x(const uint32_t *src, int srcWidth, int srcHeight, int srcStride,
+                        uint32_t *dst, int dstStride)
+{
+    for (int y = 0; y < srcHeight; y++) {
+        const uint32_t *s = src + y * srcStride;
+        uint32_t *d0 = dst + 2 * y * dstStride;
+        uint32_t *d1 = d0 + dstStride;
+        int x = 0;
+
+#ifdef __SSE2__
+        for (; x + 4 <= srcWidth; x += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i *) (s + x));
+            __m128i lo = _mm_unpacklo_epi32(p, p);
+            __m128i hi = _mm_unpackhi_epi32(p, p);
+
+            _mm_storeu_si128((__m128i *) (d0 + 2 * x), lo);
+            _mm_storeu_si128((__m128i *) (d0 + 2 * x + 4), hi);
+            _mm_storeu_si128((__m128i *) (d1 + 2 * x), lo);
+            _mm_storeu_si128((__m128i *) (d1 + 2 * x + 4), hi);
+        }
+#endif
+
+        for (; x < srcWidth; x++) {
+            d0[2 * x] = d0[2 * x + 1] = s[x];
+            d1[2 * x] = d1[2 * x + 1] = s[x];
+        }
+    }
+}
+
+// Upscales to the full output, with the exact 2x filter when the sizes allow it
+void Upscaler_Upscale(Upscaler *upscaler, const uint32_t *src, int srcWidth, int srcHeight, int srcStride,
+                      uint32_t *dst, int dstStride)
+{
+    if (srcWidth * 2 == upscaler->dstWidth && srcHeight * 2 == upscaler->dstHeight) {
+        Upscaler_Integer2x(src, srcWidth, srcHeight, srcStride, dst, dstStride);
+    } else {
+        Upscaler_Bilinear(upscaler, src, srcWidth, srcHeight, srcStride, dst, dstStride);
+    }
+}
+
+#endif
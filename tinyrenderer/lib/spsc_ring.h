@@ -0,0 +1,103 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// Bounded single producer, single consumer queue of pointers. Push and pop
+// are lock free: each side owns one index and publishes it with a release
+// store. A consumer finding the ring empty spins briefly and then sleeps on
+// the producer index with a futex, so an idle stage costs no CPU.
+
+#define SPSC_RING_SPINS 256
+
+typedef struct {
+    _Alignas(64) _Atomic uint32_t tail;     // Next slot the producer fills
+    _Alignas(64) _Atomic uint32_t head;     // Next slot the consumer takes
+    _Atomic uint32_t sleeping;              // Consumer is, or is about to be, waiting on tail
+    uint32_t mask;
+    void **items;
+} SPSCRing;
+
+// capacity is rounded up to a power of two
+void SPSCRing_Init(SPSCRing *ring, uint32_t capacity)
+{
+    uint32_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->sleeping, 0);
+    ring->mask = size - 1;
+    ring->items = calloc(size, sizeof(void *));
+}
+
+void SPSCRing_Destroy(SPSCRing *ring)
+{
+    free(ring->items);
+    ring->items = NULL;
+}
+
+// Returns 0 when the ring is full
+int SPSCRing_Push(SPSCRing *ring, void *item)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (tail - head > ring->mask) return 0;
+
+    ring->items[tail & ring->mask] = item;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_seq_cst);
+
+    // Pairs with the seq_cst store of sleeping in SPSCRing_PopWait
+    if (atomic_load_explicit(&ring->sleeping, memory_order_seq_cst)) {
+        syscall(SYS_futex, &ring->tail, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+
+    return 1;
+}
+
+// Returns NULL when the ring is empty
+void* SPSCRing_Pop(SPSCRing *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head == tail) return NULL;
+
+    void *item = ring->items[head & ring->mask];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return item;
+}
+
+// Blocks until there is an item
+void* SPSCRing_PopWait(SPSCRing *ring)
+{
+    for (;;) {
+        for (int i = 0; i < SPSC_RING_SPINS; i++) {
+            void *item = SPSCRing_Pop(ring);
+            if (item) return item;
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+        atomic_store_explicit(&ring->sleeping, 1, memory_order_seq_cst);
+        if (tail == atomic_load_explicit(&ring->head, memory_order_relaxed)
+            && tail == atomic_load_explicit(&ring->tail, memory_order_seq_cst)) {
+            // Returns at once if the producer moved tail in the meantime
+            syscall(SYS_futex, &ring->tail, FUTEX_WAIT_PRIVATE, tail, NULL, NULL, 0);
+        }
+        atomic_store_explicit(&ring->sleeping, 0, memory_order_relaxed);
+    }
+}
+
+#endif
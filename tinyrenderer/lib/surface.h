@@ -0,0 +1,190 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "tga.h"
+#include "wavefront_obj.h"
+#include "render.h"
+
+// Render surfaces that live across frames: allocated and faulted in once,
+// then cleared in place every frame. A surface remembers
+// the area drawn since the last clear, so the next clear only touches that.
+// Large clears use streaming stores, which skip reading the old contents
+// into the cache just to overwrite them. The rasterizer keeps no depth
+// buffer, so there is none to clear.
+
+typedef struct {
+    int x0, y0;                 // Inclusive
+    int x1, y1;                 // Exclusive
+} SurfaceRect;
+
+typedef struct {
+    TGAImage image;
+    size_t capacity;            // Pixels allocated, the image may use fewer after Surface_Resize
+    SurfaceRect damage;         // Drawn since the last clear, empty when x0 >= x1
+} Surface;
+
+#define SURFACE_STREAM_MIN 1024  // Below this many bytes plain stores are faster
+
+// Fills count BGR24 pixels. The 3 byte pattern repeats every 48 bytes, so
+// after aligning dst it is streamed out as three rotating 16 byte vectors.
+// Grey, black included, is the same three vectors of one byte, only small
+// fills of it go to memset.
+void surfaceFill24(TGAPixel *dst, size_t count, TGAPixel color)
+{
+    uint8_t *d = (uint8_t *) dst;
+    size_t bytes = count * sizeof(TGAPixel);
+    const uint8_t pattern[3] = { color.B, color.G, color.R };
+    size_t i = 0;
+
+    if (color.B == color.G && color.G == color.R && bytes < SURFACE_STREAM_MIN) {
+        memset(d, color.B, bytes);
+        return;
+    }
+
+#ifdef __SSE2__
+    if (bytes >= SURFACE_STREAM_MIN) {
+        for (; ((uintptr_t) (d + i) & 15) != 0; i++) {
+            d[i] = pattern[i % 3];
+        }
+
+        uint8_t block[48];
+        for (int k = 0; k < 48; k++) {
+            block[k] = pattern[(i + k) % 3];
+        }
+        __m128i v0 = _mm_loadu_si128((const __m128i *) block);
+        __m128i v1 = _mm_loadu_si128((const __m128i *) (block + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *) (block + 32));
+
+        for (; i + 48 <= bytes; i += 48) {
+            _mm_stream_si128((__m128i *) (d + i), v0);
+            _mm_stream_si128((__m128i *) (d + i + 16), v1);
+            _mm_stream_si128((__m128i *) (d + i + 32), v2);
+        }
+        _mm_sfence();
+    }
+#endif
+
+    for (; i < bytes; i++) {
+        d[i] = pattern[i % 3];
+    }
+}
+
+Surface Surface_Create(int width, int height)
+{
+    Surface surface = {
+        .image = tgaCreateImage(width, height),
+        .capacity = (size_t) width * height
+    };
+
+    // Touch every page now so the frame loop never takes a first-write fault
+    memset(surface.image.pixels, 0, (size_t) width * height * sizeof(TGAPixel));
+
+    return surface;
+}
+
+void Surface_Destroy(Surface *surface)
+{
+    free(surface->image.pixels);
+    surface->image.pixels = NULL;
+}
+
+void Surface_Damage(Surface *surface, int x0, int y0, int x1, int y1)
+{
+    SurfaceRect *d = &surface->damage;
+
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > surface->image.header.width) x1 = surface->image.header.width;
+    if (y1 > surface->image.header.height) y1 = surface->image.header.height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    if (d->x0 >= d->x1) {
+        *d = (SurfaceRect) { x0, y0, x1, y1 };
+        return;
+    }
+
+    if (x0 < d->x0) d->x0 = x0;
+    if (y0 < d->y0) d->y0 = y0;
+    if (x1 > d->x1) d->x1 = x1;
+    if (y1 > d->y1) d->y1 = y1;
+}
+
+// Changes the used size within the allocation, for dynamic resolution.
+// The whole new area counts as damaged since its pixels were laid out for another width.
+void Surface_Resize(Surface *surface, int width, int height)
+{
+    if (width == surface->image.header.width && height == surface->image.header.height) return;
+    if ((size_t) width * height > surface->capacity) return;
+
+    surface->image.header.width = width;
+    surface->image.header.height = height;
+    surface->damage = (SurfaceRect) { 0, 0, 0, 0 };
+    Surface_Damage(surface, 0, 0, width, height);
+}
+
+// Clears the damaged area to color, then marks the surface clean
+void Surface_Clear(Surface *surface, TGAPixel color)
+{
+    SurfaceRect d = surface->damage;
+    int width = surface->image.header.width;
+
+    if (d.x0 >= d.x1) return;
+
+    if (d.x0 == 0 && d.x1 == width) {
+        // Full rows are contiguous, clear them in one go
+        size_t offset = (size_t) d.y0 * width;
+        size_t count = (size_t) (d.y1 - d.y0) * width;
+
+        surfaceFill24(surface->image.pixels + offset, count, color);
+    } else {
+        for (int y = d.y0; y < d.y1; y++) {
+            size_t offset = (size_t) y * width + d.x0;
+
+            surfaceFill24(surface->image.pixels + offset, d.x1 - d.x0, color);
+        }
+    }
+
+    surface->damage = (SurfaceRect) { 0, 0, 0, 0 };
+}
+
+void Surface_ClearAll(Surface *surface, TGAPixel color)
+{
+    Surface_Damage(surface, 0, 0, surface->image.header.width, surface->image.header.height);
+    Surface_Clear(surface, color);
+}
+
+// drawMeshRotated into the surface, recording the projected bounds as damage
+void Surface_DrawMeshRotated(Surface *surface, Mesh *mesh, TGAPixel color, float angle)
+{
+    int width = surface->image.header.width;
+    int height = surface->image.header.height;
+    float c = cosf(angle);
+    float s = sinf(angle);
+    int x0 = width, y0 = height, x1 = -1, y1 = -1;
+
+    for (int i = 0; i < mesh->trisSize; i++) {
+        Vertex3D *v = &mesh->tris[i].v0;
+
+        for (int k = 0; k < 3; k++) {
+            int x = projectX(c * v[k].x + s * v[k].z, width);
+            int y = projectY(v[k].y, height);
+
+            if (x < x0) x0 = x;
+            if (x > x1) x1 = x;
+            if (y < y0) y0 = y;
+            if (y > y1) y1 = y;
+        }
+    }
+
+    drawMeshRotated(mesh, &surface->image, color, angle);
+    Surface_Damage(surface, x0, y0, x1 + 1, y1 + 1);
+}
+
+#endif
@@ -2,8 +2,13 @@
 #define TGA_H
 
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "profile.h"
 
 #pragma pack(push, 1)
 typedef struct {
@@ -33,33 +38,42 @@ typedef struct {
 typedef struct {
     TGAHeader header;
     TGAPixel *pixels;
+    uint8_t *mapping;       // Whole file when created with tgaCreateMappedImage, otherwise NULL
 } TGAImage;
 
 const TGAPixel white = { .B = 255, .G = 255, .R = 255 };
 const TGAPixel red = { .R = 255 };
+const TGAPixel black = { 0 };
 const TGAPixel blue = { .B = 255 };
 const TGAPixel green = { .G = 255 };
 
+TGAHeader tgaCreateHeader(int width, int height)
+{
+    TGAHeader header = {
+        .idLength = 0,
+        .colorMapType = 0,
+        .imageType = 2,          // Uncompressed true color
+        .firstPaletteEntry = 0,
+        .numPaletteEntries = 0,
+        .paletteBits = 0,
+        .xOrigin = 0,
+        .yOrigin = 0,   
+        .width = width,
+        .height = height,
+        .depth = 24,              // 8 bits per pixel (grayscale)
+        .descriptor = 0x20       // Upper-left origin
+    };
+
+    return header;
+}
+
 TGAImage tgaCreateImage(int width, int height)
 {
     TGAImage image = {
-        .header = {
-            .idLength = 0,
-            .colorMapType = 0,
-            .imageType = 2,          // Uncompressed true color
-            .firstPaletteEntry = 0,
-            .numPaletteEntries = 0,
-            .paletteBits = 0,
-            .xOrigin = 0,
-            .yOrigin = 0,   
-            .width = width,
-            .height = height,
-            .depth = 24,              // 8 bits per pixel (grayscale)
-            .descriptor = 0x20       // Upper-left origin
-        }
+        .header = tgaCreateHeader(width, height)
     };
 
-    image.pixels = calloc(width*height, sizeof(TGAPixel));
+    image.pixels = calloc((size_t) width * height, sizeof(TGAPixel));
 
     return image;
 }
@@ -70,18 +84,78 @@ void tgaSetPixel(TGAImage *image, int x, int y, TGAPixel pixel)
     if (x < 0 || x >= image->header.width) return;
     if (y < 0 || y >= image->header.height) return;
 
-    image->pixels[image->header.width*y + x] = pixel;
+    image->pixels[(size_t) image->header.width * y + x] = pixel;
 }
 
-void tgaSaveImage(TGAImage *image, char *path)
+void tgaSaveImage(TGAImage *image, const char *path)
 {
+    PROFILE_SCOPE("save");
+
     FILE *imageFile = fopen(path, "wb");
 
     fwrite(&image->header, sizeof(TGAHeader), 1, imageFile);
 
-    fwrite(image->pixels, sizeof(TGAPixel), image->header.width * image->header.height, imageFile);
+    fwrite(image->pixels, sizeof(TGAPixel), (size_t) image->header.width * image->header.height, imageFile);
 
     fclose(imageFile);
 }
 
+size_t tgaFileSize(int width, int height)
+{
+    return sizeof(TGAHeader) + (size_t) width * height * sizeof(TGAPixel);
+}
+
+// Creates the image directly in the page cache: the file is sized, the
+// header written and the pixels mapped with MAP_SHARED, so drawing writes
+// the file and no separate pixel buffer exists. Finish with tgaCloseMappedImage.
+TGAImage tgaCreateMappedImage(const char *path, int width, int height)
+{
+    TGAImage image = {
+        .header = tgaCreateHeader(width, height)
+    };
+    size_t size = tgaFileSize(width, height);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Failed to open image file");
+        return image;
+    }
+
+    // The file starts as a hole, so the pixels start out black without being touched
+    if (ftruncate(fd, size) < 0) {
+        perror("Failed to size image file");
+        close(fd);
+        return image;
+    }
+
+    void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        perror("Failed to map image file");
+        return image;
+    }
+
+    image.mapping = mapping;
+    memcpy(image.mapping, &image.header, sizeof(TGAHeader));
+    image.pixels = (TGAPixel *) (image.mapping + sizeof(TGAHeader));
+
+    return image;
+}
+
+// "Saves" a mapped image: with sync the call waits until the pages are on disk,
+// otherwise the kernel writes them back in its own time
+void tgaCloseMappedImage(TGAImage *image, int sync)
+{
+    if (!image->mapping) return;
+
+    size_t size = tgaFileSize(image->header.width, image->header.height);
+
+    if (sync) msync(image->mapping, size, MS_SYNC);
+    munmap(image->mapping, size);
+
+    image->mapping = NULL;
+    image->pixels = NULL;
+}
+
 #endif
\ No newline at end of file
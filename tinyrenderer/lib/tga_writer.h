@@ -0,0 +1,80 @@
+#ifndef TGA_WRITER_H
+#define TGA_WRITER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "tga.h"
+#include "profile.h"
+
+// Frame buffers for saving TGA sequences. Each slot holds the header and the
+// pixels back to back in one page aligned block, so a frame goes to disk with
+// a single pwrite, or with TGA_WRITER_DIRECT as whole pages through O_DIRECT
+// and is truncated to the real size afterwards. O_DIRECT needs _GNU_SOURCE
+// defined before the first system header. frame_pipeline.h drives the slots
+// from its writer thread.
+
+#define TGA_WRITER_DIRECT 1
+#define TGA_WRITER_ALIGN 4096
+#define TGA_WRITER_PATH_MAX 256
+
+typedef struct {
+    TGAImage image;
+    uint8_t *block;             // Page aligned, header followed by pixels
+    char path[TGA_WRITER_PATH_MAX];
+} TGAWriterSlot;
+
+// Sets up one frame buffer
+void TGAWriterSlot_Init(TGAWriterSlot *slot, int width, int height)
+{
+    size_t size = tgaFileSize(width, height);
+    size_t rounded = (size + TGA_WRITER_ALIGN - 1) & ~(size_t) (TGA_WRITER_ALIGN - 1);
+
+    slot->image.header = tgaCreateHeader(width, height);
+    slot->block = aligned_alloc(TGA_WRITER_ALIGN, rounded);
+    memcpy(slot->block, &slot->image.header, sizeof(TGAHeader));
+    slot->image.pixels = (TGAPixel *) (slot->block + sizeof(TGAHeader));
+}
+
+// Saves the slot's image as slot->path, flags is 0 or TGA_WRITER_DIRECT
+int TGAWriterSlot_Write(TGAWriterSlot *slot, int flags)
+{
+    PROFILE_SCOPE("save");
+    size_t size = tgaFileSize(slot->image.header.width, slot->image.header.height);
+    int direct = flags & TGA_WRITER_DIRECT;
+
+    int fd = open(slot->path, O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0644);
+    if (fd < 0 && direct) {
+        // Some filesystems (tmpfs) refuse O_DIRECT, write through the page cache there
+        fd = open(slot->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        direct = 0;
+    }
+    if (fd < 0) {
+        perror(slot->path);
+        return -1;
+    }
+
+    // The header and pixels are contiguous in block, so a short write goes on
+    // from block + done. O_DIRECT writes whole pages, short ones end on a page.
+    size_t total = direct ? (size + TGA_WRITER_ALIGN - 1) & ~(size_t) (TGA_WRITER_ALIGN - 1) : size;
+    size_t done = 0;
+    while (done < total) {
+        ssize_t written = pwrite(fd, slot->block + done, total - done, done);
+        if (written <= 0) break;
+        done += written;
+    }
+    if (done == total && direct && ftruncate(fd, size) != 0) done = 0;
+
+    close(fd);
+
+    if (done != total) {
+        fprintf(stderr, "Failed to write %s\n", slot->path);
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif
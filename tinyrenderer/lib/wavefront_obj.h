@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include "arena.h"
+#include "profile.h"
 
 typedef struct {
     float x;
@@ -68,20 +70,21 @@ typedef struct
 } Mesh;
 
 
-Mesh OBJ_Model_mesh(OBJ_Model *model)
+// Address space to reserve for a model arena; pages are only committed as the mesh fills it
+#define MODEL_ARENA_RESERVE ((size_t) 1 << 30)
+
+// Builds the triangle list in arena, so it goes away with the arena instead of leaking
+Mesh OBJ_Model_mesh(OBJ_Model *model, Arena *arena)
 {
+    PROFILE_SCOPE("mesh build");
     Mesh mesh;
 
-    mesh.trisSize = model->faceSize;
-    mesh.tris = malloc(mesh.trisSize * sizeof(Triangle));
+    mesh.tris = ARENA_NEW(arena, Triangle, model->faceSize);
+    mesh.trisSize = mesh.tris ? model->faceSize : 0;
 
-    for (int i = 0; i < model->faceSize; i++) {
+    for (int i = 0; i < mesh.trisSize; i++) {
         Face32 face = model->faceData[i];
 
-        Vertex3D v0 = model->vertexData[face.v0];
-        Vertex3D v1 = model->vertexData[face.v1];
-        Vertex3D v2 = model->vertexData[face.v2];
-
         mesh.tris[i] = (Triangle) {
             .v0 = model->vertexData[face.v0],
             .v1 = model->vertexData[face.v1],
@@ -99,6 +102,8 @@ int OBJ_Model_parse(const char *filename, OBJ_Model *model)
     char *token;
     int vIdx;
 
+    PROFILE_SCOPE("parse");
+
     fd = fopen(filename, "r");
    
     if (!fd) {
@@ -109,10 +114,9 @@ int OBJ_Model_parse(const char *filename, OBJ_Model *model)
     while (fgets(buffer, sizeof(buffer), fd) != NULL)
     {    
         if (buffer[0] == 'v' && buffer[1] == ' ') {
-            Vertex3D vertex;
+            Vertex3D vertex = { 0 };
 
-            if (sscanf(buffer, "v %f %f", &vertex.x, &vertex.y)) {
-                printf("Parsed x:%.9f y:%.9f\n", vertex.x, vertex.y);
+            if (sscanf(buffer, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z) >= 2) {
                 OBJ_Model_add_vertex(model, vertex);
             } else {
                 fprintf(stderr, "Failed to parse vertex: %s", buffer);
@@ -142,11 +146,13 @@ int OBJ_Model_parse(const char *filename, OBJ_Model *model)
                     .v2 = indices[i + 1]
                 };
                 OBJ_Model_add_face(model, face);
-
-                printf("Parsed %d->%d->%d,\n", face.v0, face.v1, face.v2);
             }
         }
     }
+
+    fclose(fd);
+
+    return 0;
 }
 
 #endif
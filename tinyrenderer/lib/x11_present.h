@@ -0,0 +1,241 @@
+#ifndef X11_PRESENT_H
+#define X11_PRESENT_H
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// Presents XRGB8888 frames into a window. The pixel buffers live in SysV
+// shared memory attached with XShmAttach, so XShmPutImage only sends a small
+// request and the server reads the pixels directly. When MIT-SHM is missing
+// (remote display, or X11_PRESENT_NOSHM is set) it falls back to XPutImage.
+
+#define X11_PRESENT_BUFFERS 2
+
+typedef struct {
+    XImage *image;
+    XShmSegmentInfo shm;
+    int busy;                   // XShmPutImage sent, ShmCompletion not yet received
+} X11PresentBuffer;
+
+typedef struct {
+    Display *display;
+    Window window;
+    GC gc;
+    int width;
+    int height;
+    int useShm;
+    int completionType;         // Event type of ShmCompletion on this display
+    int current;                // Index of the back buffer
+    X11PresentBuffer buffers[X11_PRESENT_BUFFERS];
+} X11Present;
+
+static int x11PresentAttachFailed;
+
+static int X11Present_AttachErrorHandler(Display *display, XErrorEvent *error)
+{
+    x11PresentAttachFailed = 1;
+    return 0;
+}
+
+int X11Present_CreateShmBuffer(X11Present *present, X11PresentBuffer *buffer, Visual *visual, int depth)
+{
+    buffer->image = XShmCreateImage(present->display, visual, depth, ZPixmap, NULL,
+                                    &buffer->shm, present->width, present->height);
+    if (!buffer->image) return -1;
+
+    buffer->shm.shmid = shmget(IPC_PRIVATE, buffer->image->bytes_per_line * buffer->image->height,
+                               IPC_CREAT | 0600);
+    if (buffer->shm.shmid < 0) {
+        XDestroyImage(buffer->image);
+        buffer->image = NULL;
+        return -1;
+    }
+
+    buffer->shm.shmaddr = buffer->image->data = shmat(buffer->shm.shmid, NULL, 0);
+    buffer->shm.readOnly = False;
+
+    if (buffer->shm.shmaddr == (char *) -1) {
+        shmctl(buffer->shm.shmid, IPC_RMID, NULL);
+        buffer->image->data = NULL;
+        XDestroyImage(buffer->image);
+        buffer->image = NULL;
+        return -1;
+    }
+
+    // A remote server accepts the extension but fails the attach asynchronously
+    x11PresentAttachFailed = 0;
+    XErrorHandler oldHandler = XSetErrorHandler(X11Present_AttachErrorHandler);
+    XShmAttach(present->display, &buffer->shm);
+    XSync(present->display, False);
+    XSetErrorHandler(oldHandler);
+
+    // The segment goes away once both sides detach
+    shmctl(buffer->shm.shmid, IPC_RMID, NULL);
+
+    if (x11PresentAttachFailed) {
+        shmdt(buffer->shm.shmaddr);
+        buffer->image->data = NULL;
+        XDestroyImage(buffer->image);
+        buffer->image = NULL;
+        return -1;
+    }
+
+    buffer->busy = 0;
+    return 0;
+}
+
+int X11Present_CreateImageBuffer(X11Present *present, X11PresentBuffer *buffer, Visual *visual, int depth)
+{
+    char *data = malloc(present->width * present->height * 4);
+    if (!data) return -1;
+
+    buffer->image = XCreateImage(present->display, visual, depth, ZPixmap, 0, data,
+                                 present->width, present->height, 32, 0);
+    if (!buffer->image) {
+        free(data);
+        return -1;
+    }
+
+    buffer->busy = 0;
+    return 0;
+}
+
+void X11Present_DestroyBuffer(X11Present *present, X11PresentBuffer *buffer)
+{
+    if (!buffer->image) return;
+
+    if (present->useShm) {
+        XShmDetach(present->display, &buffer->shm);
+        shmdt(buffer->shm.shmaddr);
+        buffer->image->data = NULL;
+    }
+
+    XDestroyImage(buffer->image);
+    buffer->image = NULL;
+}
+
+X11Present* X11Present_Create(Display *display, Window window, int width, int height)
+{
+    X11Present *present;
+    Visual *visual;
+    int depth;
+
+    int screen = XDefaultScreen(display);
+
+    visual = XDefaultVisual(display, screen);
+    depth = XDefaultDepth(display, screen);
+
+    if (visual->class != TrueColor || depth < 24) {
+        fprintf(stderr, "X11Present: only 24/32 bit TrueColor visuals are supported\n");
+        return NULL;
+    }
+
+    present = calloc(1, sizeof(X11Present));
+    present->display = display;
+    present->window = window;
+    present->gc = XCreateGC(display, window, 0, NULL);
+    present->width = width;
+    present->height = height;
+
+    present->useShm = XShmQueryExtension(display) && !getenv("X11_PRESENT_NOSHM");
+    if (present->useShm) {
+        present->completionType = XShmGetEventBase(display) + ShmCompletion;
+
+        for (int i = 0; i < X11_PRESENT_BUFFERS; i++) {
+            if (X11Present_CreateShmBuffer(present, &present->buffers[i], visual, depth) < 0) {
+                for (int j = 0; j < i; j++) {
+                    X11Present_DestroyBuffer(present, &present->buffers[j]);
+                }
+                present->useShm = 0;
+                break;
+            }
+        }
+    }
+
+    if (!present->useShm) {
+        fprintf(stderr, "X11Present: MIT-SHM unavailable, falling back to XPutImage\n");
+
+        // XPutImage copies the pixels into the request, so one buffer is enough
+        if (X11Present_CreateImageBuffer(present, &present->buffers[0], visual, depth) < 0) {
+            XFreeGC(display, present->gc);
+            free(present);
+            return NULL;
+        }
+    }
+
+    return present;
+}
+
+// Returns non-zero if the event belonged to the presenter
+int X11Present_HandleEvent(X11Present *present, XEvent *event)
+{
+    if (!present->useShm || event->type != present->completionType) return 0;
+
+    XShmCompletionEvent *completion = (XShmCompletionEvent *) event;
+    for (int i = 0; i < X11_PRESENT_BUFFERS; i++) {
+        if (present->buffers[i].shm.shmseg == completion->shmseg) {
+            present->buffers[i].busy = 0;
+        }
+    }
+
+    return 1;
+}
+
+static Bool X11Present_IsCompletion(Display *display, XEvent *event, XPointer arg)
+{
+    return event->type == ((X11Present *) arg)->completionType;
+}
+
+// Returns the back buffer, waiting until the server has finished reading it.
+// stride receives the length of a row in pixels.
+uint32_t* X11Present_BackBuffer(X11Present *present, int *stride)
+{
+    X11PresentBuffer *buffer = &present->buffers[present->current];
+
+    while (buffer->busy) {
+        XEvent event;
+        XIfEvent(present->display, &event, X11Present_IsCompletion, (XPointer) present);
+        X11Present_HandleEvent(present, &event);
+    }
+
+    if (stride) *stride = buffer->image->bytes_per_line / 4;
+
+    return (uint32_t *) buffer->image->data;
+}
+
+// Sends a region of the back buffer to the window and flips to the next buffer.
+// With MIT-SHM the buffer stays busy until its ShmCompletion event arrives.
+void X11Present_Blit(X11Present *present, int x, int y, int width, int height)
+{
+    X11PresentBuffer *buffer = &present->buffers[present->current];
+
+    if (present->useShm) {
+        XShmPutImage(present->display, present->window, present->gc, buffer->image,
+                     x, y, x, y, width, height, True);
+        buffer->busy = 1;
+        present->current = (present->current + 1) % X11_PRESENT_BUFFERS;
+    } else {
+        XPutImage(present->display, present->window, present->gc, buffer->image,
+                  x, y, x, y, width, height);
+    }
+
+    XFlush(present->display);
+}
+
+void X11Present_Destroy(X11Present *present)
+{
+    for (int i = 0; i < X11_PRESENT_BUFFERS; i++) {
+        X11Present_DestroyBuffer(present, &present->buffers[i]);
+    }
+
+    XFreeGC(present->display, present->gc);
+    free(present);
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "lib/tga.h"
+#include "lib/wavefront_obj.h"
+#include "lib/render.h"
+#include "lib/arena.h"
+#include "lib/instance.h"
+#include "lib/quantized_mesh.h"
+
+// Compares float and quantized meshes: memory, transform speed, drawing
+// speed and how far the quantized vertices land from the float ones at 4K.
+// The head is tiled into an 8x8 grid to get past 65536 vertices, so the
+// large mesh uses the delta coded indices. Every mesh is first checked to
+// decode back to the model's faces, the exit status is 1 if one does not.
+
+#define WIDTH 3840
+#define HEIGHT 2160
+#define TILES 8
+#define RUNS 20
+
+double nowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+// TILES x TILES copies of model side by side in [-1, 1]
+OBJ_Model tileModel(OBJ_Model *model)
+{
+    OBJ_Model tiled = { 0 };
+
+    OBJ_Model_init(&tiled);
+    for (int t = 0; t < TILES * TILES; t++) {
+        float cx = -1 + (t % TILES + 0.5f) * 2 / TILES;
+        float cy = -1 + (t / TILES + 0.5f) * 2 / TILES;
+        uint32_t base = tiled.vertexSize;
+
+        for (size_t i = 0; i < model->vertexSize; i++) {
+            Vertex3D v = model->vertexData[i];
+            OBJ_Model_add_vertex(&tiled, (Vertex3D) { cx + v.x / TILES, cy + v.y / TILES, v.z / TILES });
+        }
+        for (size_t i = 0; i < model->faceSize; i++) {
+            Face32 f = model->faceData[i];
+            OBJ_Model_add_face(&tiled, (Face32) { .v0 = base + f.v0, .v1 = base + f.v1, .v2 = base + f.v2 });
+        }
+    }
+
+    return tiled;
+}
+
+void floatTransform(const IndexedMesh *mesh, const Mat4 *transform, ScreenPoint *out)
+{
+    for (size_t v = 0; v < mesh->vertexCount; v++) {
+        Vertex3D p = Mat4_Apply(transform, mesh->vertices[v]);
+        out[v] = (ScreenPoint) { projectX(p.x, WIDTH), projectY(p.y, HEIGHT) };
+    }
+}
+
+// Decodes every index block and compares it with the model's faces
+int checkIndices(const char *name, const QuantizedMesh *mesh, OBJ_Model *model)
+{
+    const uint32_t *indices = (const uint32_t *) model->faceData;
+    uint32_t block[QMESH_BLOCK_INDICES];
+
+    for (size_t b = 0; b * QMESH_BLOCK_FACES < mesh->faceCount; b++) {
+        int count = QuantizedMesh_DecodeBlock(mesh, b, block);
+
+        for (int i = 0; i < count; i++) {
+            size_t at = b * QMESH_BLOCK_INDICES + i;
+            if (block[i] != indices[at]) {
+                fprintf(stderr, "%s: index %zu decodes to %u, expected %u\n", name, at, block[i], indices[at]);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Returns -1 if the quantized mesh could not be built or decodes wrongly
+int compare(const char *name, OBJ_Model *model, int flags)
+{
+    Arena arena = Arena_Create((size_t) 1 << 30);
+    IndexedMesh mesh = IndexedMesh_FromModel(model);
+    QuantizedMesh quantized;
+    Mat4 transform = Mat4_RotateY(0.5f);
+    size_t padded = (mesh.vertexCount + 3) & ~(size_t) 3;
+    ScreenPoint *a = malloc(padded * sizeof(ScreenPoint));
+    ScreenPoint *b = malloc(padded * sizeof(ScreenPoint));
+    TGAImage image = tgaCreateImage(WIDTH, HEIGHT);
+    Instance instance = { transform, red };
+
+    if (QuantizedMesh_FromModel(&quantized, model, &arena, flags) < 0 || checkIndices(name, &quantized, model) < 0) {
+        free(image.pixels);
+        free(a);
+        free(b);
+        Arena_Destroy(&arena);
+        return -1;
+    }
+
+    double floatMs = 1e9, quantMs = 1e9, floatDraw = 1e9, quantDraw = 1e9;
+    for (int run = 0; run < RUNS; run++) {
+        double start = nowMs();
+        floatTransform(&mesh, &transform, a);
+        floatMs = fmin(floatMs, nowMs() - start);
+
+        start = nowMs();
+        QuantizedMesh_Transform(&quantized, &transform, WIDTH, HEIGHT, b);
+        quantMs = fmin(quantMs, nowMs() - start);
+    }
+    for (int run = 0; run < RUNS / 4; run++) {
+        double start = nowMs();
+        drawInstanced(&mesh, &instance, 1, &image, 1, &arena);
+        floatDraw = fmin(floatDraw, nowMs() - start);
+
+        start = nowMs();
+        drawQuantized(&quantized, &transform, &image, red, &arena);
+        quantDraw = fmin(quantDraw, nowMs() - start);
+    }
+
+    int error = 0;
+    for (size_t v = 0; v < mesh.vertexCount; v++) {
+        int e = abs(a[v].x - b[v].x) > abs(a[v].y - b[v].y) ? abs(a[v].x - b[v].x) : abs(a[v].y - b[v].y);
+        if (e > error) error = e;
+    }
+
+    size_t floatBytes = mesh.vertexCount * sizeof(Vertex3D) + mesh.faceCount * sizeof(Face32);
+
+    printf("%-6s %7zu verts %7zu faces  %6s indices  %7zu KiB -> %6zu KiB  transform %.3f -> %.3f ms"
+           "  draw %.2f -> %.2f ms  max error %d px\n", name, mesh.vertexCount, mesh.faceCount,
+           quantized.indices16 ? "16 bit" : "delta", floatBytes / 1024, quantized.bytes / 1024,
+           floatMs, quantMs, floatDraw, quantDraw, error);
+
+    free(image.pixels);
+    free(a);
+    free(b);
+    Arena_Destroy(&arena);
+
+    return 0;
+}
+
+int main()
+{
+    OBJ_Model model = { 0 };
+
+    OBJ_Model_init(&model);
+    if (OBJ_Model_parse("model/african_head.obj", &model) < 0) return 1;
+
+    OBJ_Model tiled = tileModel(&model);
+
+    int failed = 0;
+    failed |= compare("head", &model, 0) < 0;
+    failed |= compare("head", &model, QMESH_FORCE_DELTA) < 0;
+    failed |= compare("tiled", &tiled, 0) < 0;
+
+    return failed;
+}
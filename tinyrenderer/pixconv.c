@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "lib/pixel_format.h"
+
+// Checks every conversion kernel against the scalar reference and reports
+// its throughput on 4K frames, counting bytes read plus bytes written.
+
+#define FRAME_PIXELS (3840 * 2160)
+#define RUNS 20
+
+double nowSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main()
+{
+    int failures = 0;
+
+    uint8_t *src = malloc(FRAME_PIXELS * 4);
+    uint8_t *expected = malloc(FRAME_PIXELS * 4);
+    uint8_t *actual = malloc(FRAME_PIXELS * 4);
+
+    srand(1);
+    for (int i = 0; i < FRAME_PIXELS * 4; i++) {
+        src[i] = rand();
+    }
+
+    printf("%-20s %-7s %10s\n", "kernel", "isa", "GB/s");
+
+    for (int from = 0; from < PIXEL_FORMATS; from++) {
+        for (int to = 0; to < PIXEL_FORMATS; to++) {
+            if (from == to) continue;
+
+            char name[32];
+            snprintf(name, sizeof(name), "%s->%s", pixelFormatNames[from], pixelFormatNames[to]);
+
+            size_t frameBytes = (size_t) FRAME_PIXELS * (pixelFormatBytes[from] + pixelFormatBytes[to]);
+
+            for (int isa = 0; isa < PIXEL_ISAS; isa++) {
+                PixelConvertFn kernel = pixelKernels[isa][from][to];
+                if (!kernel || !pixelIsaSupported(isa)) continue;
+
+                // Odd lengths exercise the scalar tails of the vector loops
+                for (size_t count = 0; count < 100; count++) {
+                    memset(expected, 0xAA, count * 4 + 8);
+                    memset(actual, 0xAA, count * 4 + 8);
+                    pixelKernels[PIXEL_ISA_SCALAR][from][to](src + 7, expected, count);
+                    kernel(src + 7, actual, count);
+
+                    if (memcmp(expected, actual, count * pixelFormatBytes[to] + 8) != 0) {
+                        printf("%s %s: mismatch at %zu pixels\n", name, pixelIsaNames[isa], count);
+                        failures++;
+                        break;
+                    }
+                }
+
+                kernel(src, actual, FRAME_PIXELS);
+                pixelKernels[PIXEL_ISA_SCALAR][from][to](src, expected, FRAME_PIXELS);
+                if (memcmp(expected, actual, (size_t) FRAME_PIXELS * pixelFormatBytes[to]) != 0) {
+                    printf("%s %s: frame mismatch\n", name, pixelIsaNames[isa]);
+                    failures++;
+                }
+
+                double start = nowSeconds();
+                for (int run = 0; run < RUNS; run++) {
+                    kernel(src, actual, FRAME_PIXELS);
+                }
+                double elapsed = nowSeconds() - start;
+
+                printf("%-20s %-7s %10.2f\n", name, pixelIsaNames[isa], frameBytes * RUNS / elapsed / 1e9);
+            }
+        }
+    }
+
+    printf("dispatch: %s\n", pixelIsaNames[pixelBestIsa()]);
+
+    free(src);
+    free(expected);
+    free(actual);
+
+    return failures ? 1 : 0;
+}
@@ -1,102 +1,148 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <math.h>
 #include "lib/tga.h"
 #include "lib/wavefront_obj.h"
-
-void drawLine(int x0, int y0, int x1, int y1, TGAImage *image, TGAPixel color)
+#include "lib/render.h"
+#include "lib/font.h"
+#include "lib/tga_writer.h"
+#include "lib/band.h"
+#include "lib/surface.h"
+#include "lib/arena.h"
+#include "lib/frame_pipeline.h"
+#include "lib/profile.h"
+
+double elapsedMs(struct timespec *start)
 {
-    // https://zingl.github.io/bresenham.html
-    int dx = abs(x1 - x0);
-    int sx = x0 < x1 ? 1 : -1;
-    int dy = -abs(y1 - y0);
-    int sy = y0 < y1 ? 1 : -1;
-    int err = dx + dy;  // error value
-
-    for (;;) {
-        tgaSetPixel(image, x0, y0, color);
-        if (x0 == x1 && y0 == y1) break;
-        int e2 = 2 * err;
-        if (e2 >= dy) { err += dy; x0 += sx; }
-        if (e2 <= dx) { err += dx; y0 += sy; }
-    }
-}
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-void drawTriangle(Vertex3D v0, Vertex3D v1, Vertex3D v2, TGAImage *image, TGAPixel color)
-{
-    drawLine(v0.x, v0.y, v1.x, v1.y, image, color);
-    drawLine(v1.x, v1.y, v2.x, v2.y, image, color);
-    drawLine(v2.x, v2.y, v0.x, v0.y, image, color);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
 }
 
-int projectX(float x, int width)
+// Renders a turntable of the model as frame_0000.tga, frame_0001.tga, ...
+// Transform, raster and writing run as a pipeline, see lib/frame_pipeline.h.
+// With slowFrameMs set, frames taking longer leave a slow_frame_NNNN.json trace.
+int renderSequence(OBJ_Model *model, int width, int height, int frames, int inFlight, int writerFlags, int hud,
+                   double slowFrameMs)
 {
-    int min_x, max_x;
-    float u;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Arena modelArena = Arena_Create(MODEL_ARENA_RESERVE);
+    Mesh mesh = OBJ_Model_mesh(model, &modelArena);
+    FontAtlas *font = hud ? FontAtlas_Create(1) : NULL;
+    double busyMs[PIPELINE_STAGES];
+
+    int failures = renderPipelined(&mesh, width, height, frames, inFlight, writerFlags, font, slowFrameMs, busyMs);
+    double totalMs = elapsedMs(&start);
 
-    min_x = -1;
-    max_x = 1;
+    printf("%d frames in %.1f ms, %.1f frames/s\n", frames, totalMs, frames * 1000.0 / totalMs);
+    printf("busy: transform %.1f ms, raster %.1f ms, write %.1f ms\n",
+           busyMs[PIPELINE_TRANSFORM], busyMs[PIPELINE_RASTER], busyMs[PIPELINE_WRITE]);
 
-    u = (x - min_x) / (max_x - min_x);
+    if (font) FontAtlas_Destroy(font);
+    Arena_Destroy(&modelArena);
 
-    return u * (width-1);
+    return failures ? 1 : 0;
 }
 
-int projectY(float y, int height)
+// Renders one image of the model as sample.tga
+int renderImage(OBJ_Model *model, Arena *arena, int width, int height, int mapped, int hud)
 {
-    int min_y, max_y;
-    float v;
+    // --mmap renders straight into the page cache of sample.tga
+    TGAImage image = mapped ? tgaCreateMappedImage("sample.tga", width, height)
+                            : tgaCreateImage(width, height);
+    if (!image.pixels) return 1;
 
-    min_y = -1;
-    max_y = 1;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-    v = (y - min_y) / (max_y - min_y);
+    Mesh mesh = OBJ_Model_mesh(model, arena);
+    drawMesh(&mesh, &image, red);
+
+    if (hud) {
+        char text[64];
+        FontAtlas *font = FontAtlas_Create(1);
+
+        snprintf(text, sizeof(text), "tris: %zu  raster: %.3f ms", mesh.trisSize, elapsedMs(&start));
+        Font_DrawTextTGA(font, &image, 8, 8, text, white, 255);
+
+        FontAtlas_Destroy(font);
+    }
+
+    if (mapped) {
+        tgaCloseMappedImage(&image, 0);
+    } else {
+        tgaSaveImage(&image, "sample.tga");
+    }
+    PROFILE_SAMPLE();
 
-    return (1-v) * (height-1);
+    return 0;
 }
 
-int main()
+int main(int argc, char **argv)
 {
     int imgWidth = 800;
     int imgHeight = 800;
-
-    OBJ_Model model;
-
-    OBJ_Model_init(&model);
- 
-    OBJ_Model_parse("model/cube.obj", &model);
-
-    for (int i = 0; i < model.vertexSize; i++) {
-        printf("x:%.9f, y:%.9f \n", model.vertexData[i].x, model.vertexData[i].y);
+    int hud = 0;
+    int frames = 0;
+    int writerFlags = 0;
+    int mapped = 0;
+    int bandHeight = 0;
+    int threads = 1;
+    int inFlight = 3;
+    double slowFrameMs = 0;
+    const char *tracePath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--hud") == 0) hud = 1;
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = atoi(argv[++i]);
+        if (strcmp(argv[i], "--in-flight") == 0 && i + 1 < argc) inFlight = atoi(argv[++i]);
+        if (strcmp(argv[i], "--direct") == 0) writerFlags |= TGA_WRITER_DIRECT;
+        if (strcmp(argv[i], "--mmap") == 0) mapped = 1;
+        if (strcmp(argv[i], "--bands") == 0 && i + 1 < argc) bandHeight = atoi(argv[++i]);
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            // TGA stores each side in 16 bits
+            if (sscanf(argv[++i], "%dx%d", &imgWidth, &imgHeight) != 2
+                || imgWidth < 1 || imgWidth > 65535 || imgHeight < 1 || imgHeight > 65535) {
+                fprintf(stderr, "--size takes WIDTHxHEIGHT, 1 to 65535 pixels per side\n");
+                return 1;
+            }
+        }
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) tracePath = argv[++i];
+        if (strcmp(argv[i], "--slow-frame") == 0 && i + 1 < argc) slowFrameMs = atof(argv[++i]);
     }
 
-    for (int i = 0; i < model.faceSize; i++) {
-        printf("%d->%d->%d \n", model.faceData[i].v0, model.faceData[i].v1, model.faceData[i].v2);
+#ifndef PROFILE
+    if (tracePath || slowFrameMs > 0) {
+        fprintf(stderr, "Tracing needs a build with -DPROFILE (make renderer-profile)\n");
     }
+#endif
 
-    TGAImage image = tgaCreateImage(imgWidth, imgHeight);
-
-    Mesh mesh = OBJ_Model_mesh(&model);
-    for (int i = 0; i < mesh.trisSize; i++) {
-        Triangle triangle = mesh.tris[i];
-
-        Vertex3D v0 = triangle.v0;
-        Vertex3D v1 = triangle.v1;
-        Vertex3D v2 = triangle.v2;
-        
-        v0.x = projectX(v0.x, imgWidth);
-        v0.y = projectY(v0.y, imgWidth);
-        v1.x = projectX(v1.x, imgWidth);
-        v1.y = projectY(v1.y, imgWidth);
-        v2.x = projectX(v2.x, imgWidth);
-        v2.y = projectY(v2.y, imgWidth);
+    OBJ_Model model;
+    Arena modelArena = Arena_Create(MODEL_ARENA_RESERVE);
+    int result;
 
-        drawTriangle(v0, v1, v2, &image, red);
+    OBJ_Model_init(&model);
+    if (OBJ_Model_parse("model/cube.obj", &model) < 0) return 1;
+
+    if (frames > 0) {
+        result = renderSequence(&model, imgWidth, imgHeight, frames, inFlight < 1 ? 1 : inFlight, writerFlags, hud, slowFrameMs);
+    } else if (bandHeight > 0) {
+        // --bands renders the image a few rows at a time with bounded memory
+        Mesh mesh = OBJ_Model_mesh(&model, &modelArena);
+        result = renderBanded(&mesh, imgWidth, imgHeight, bandHeight, threads, red, "sample.tga") < 0;
+    } else {
+        result = renderImage(&model, &modelArena, imgWidth, imgHeight, mapped, hud);
     }
 
-    tgaSaveImage(&image, "sample.tga");
+    if (tracePath && PROFILE_WRITE_TRACE(tracePath) < 0) result = 1;
 
-    return 0;
+    return result;
 }
-
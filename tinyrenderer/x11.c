@@ -7,6 +7,17 @@
 #include <string.h>
 #include <time.h>
 #include <locale.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "lib/tga.h"
+#include "lib/wavefront_obj.h"
+#include "lib/render.h"
+#include "lib/x11_present.h"
+#include "lib/pixel_format.h"
+#include "lib/scale.h"
+#include "lib/font.h"
+#include "lib/surface.h"
 
 typedef struct {
     Display *display;
@@ -14,26 +25,45 @@ typedef struct {
     XftDraw *xft_draw;
     XftColor *color;
     XftFont *font;
+    int x;
+    int y;
+    char text[32];      // Time string currently on screen
 } StatusBar;
 
-void StatusBar_DrawCurrentTime(StatusBar *bar)
+// Formats the current time and returns non-zero if it differs from the text on screen
+int StatusBar_Update(StatusBar *bar)
 {
-    char out_buffer[255] = "HelLoOOO:)";
-    char with_format[255];
+    char out_buffer[32];
     time_t current_time;
     struct tm* timeinfo;
 
-    strcpy(with_format, "%H:%M:%S");
-
     time(&current_time);
     timeinfo = localtime(&current_time);
 
-    strftime(out_buffer, sizeof(out_buffer), with_format, timeinfo);
+    strftime(out_buffer, sizeof(out_buffer), "%H:%M:%S", timeinfo);
+
+    if (strcmp(out_buffer, bar->text) == 0) return 0;
+
+    strcpy(bar->text, out_buffer);
+    return 1;
+}
+
+// Area covered by the status text, used to repaint the frame below it
+XRectangle StatusBar_Bounds(StatusBar *bar)
+{
+    XRectangle rect = {
+        .x = bar->x,
+        .y = bar->y - bar->font->ascent,
+        .width = bar->font->max_advance_width * sizeof("00:00:00"),
+        .height = bar->font->ascent + bar->font->descent
+    };
 
-    XClearWindow(bar->display, bar->window);
+    return rect;
+}
 
-    int y = bar->font->ascent;
-    XftDrawString8(bar->xft_draw, bar->color, bar->font, 100, 50, (FcChar8*) out_buffer, strlen(out_buffer));
+void StatusBar_Draw(StatusBar *bar)
+{
+    XftDrawString8(bar->xft_draw, bar->color, bar->font, bar->x, bar->y, (FcChar8*) bar->text, strlen(bar->text));
 }
 
 StatusBar* StatusBar_Create(Display *display, Window window)
@@ -66,14 +96,171 @@ StatusBar* StatusBar_Create(Display *display, Window window)
     bar->xft_draw = draw;
     bar->color = color;
     bar->font = font;
+    bar->x = 100;
+    bar->y = 50;
+    bar->text[0] = '\0';
 
     return bar;
 }
 
-int main() {
+void Damage_Add(XRectangle *damage, int x, int y, int width, int height)
+{
+    if (damage->width == 0 || damage->height == 0) {
+        *damage = (XRectangle) { x, y, width, height };
+        return;
+    }
+
+    int x1 = damage->x + damage->width;
+    int y1 = damage->y + damage->height;
+    if (x + width > x1) x1 = x + width;
+    if (y + height > y1) y1 = y + height;
+    if (x < damage->x) damage->x = x;
+    if (y < damage->y) damage->y = y;
+
+    damage->width = x1 - damage->x;
+    damage->height = y1 - damage->y;
+}
+
+int Damage_Intersects(XRectangle *damage, XRectangle *rect)
+{
+    return damage->x < rect->x + rect->width && rect->x < damage->x + damage->width &&
+           damage->y < rect->y + rect->height && rect->y < damage->y + damage->height;
+}
+
+// Copies a region of the rendered frame into the presenter's back buffer and shows it
+void PresentFrame(X11Present *present, TGAImage *frame, XRectangle *region)
+{
+    int x0 = region->x < 0 ? 0 : region->x;
+    int y0 = region->y < 0 ? 0 : region->y;
+    int x1 = region->x + region->width;
+    int y1 = region->y + region->height;
+    if (x1 > frame->header.width) x1 = frame->header.width;
+    if (y1 > frame->header.height) y1 = frame->header.height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    int stride;
+    uint32_t *pixels = X11Present_BackBuffer(present, &stride);
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t *row = pixels + y * stride;
+        TGAPixel *src = frame->pixels + y * frame->header.width;
+        pixelConvert(PIXEL_BGR24, PIXEL_XRGB8888, src + x0, row + x0, x1 - x0);
+    }
+
+    X11Present_Blit(present, x0, y0, x1 - x0, y1 - y0);
+}
+
+double ElapsedMs(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Turntable animation rendered at a resolution that follows the raster time
+typedef struct {
+    Surface internal;           // Allocated at output size, header holds the current internal size
+    uint32_t *internalXRGB;
+    Upscaler *upscaler;
+    DynamicResolution resolution;
+    FontAtlas *font;
+    float angle;
+} DynamicFrame;
+
+DynamicFrame* DynamicFrame_Create(int width, int height)
+{
+    DynamicFrame *frame = malloc(sizeof(DynamicFrame));
+
+    frame->internal = Surface_Create(width, height);
+    frame->internalXRGB = malloc(width * height * sizeof(uint32_t));
+    frame->upscaler = Upscaler_Create(width, height);
+    frame->font = FontAtlas_Create(2);
+    frame->angle = 0;
+
+    // Leave the rest of the 16.6 ms for conversion, upscaling and presenting
+    DynamicResolution_Init(&frame->resolution, 8.0);
+
+    return frame;
+}
+
+void DynamicFrame_Present(DynamicFrame *frame, Mesh *mesh, X11Present *present)
+{
+    int width = present->width * frame->resolution.scale;
+    int height = present->height * frame->resolution.scale;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Only the area the last frame drew needs clearing, unless the size changed
+    Surface_Resize(&frame->internal, width, height);
+    Surface_Clear(&frame->internal, black);
+    Surface_DrawMeshRotated(&frame->internal, mesh, red, frame->angle);
+
+    double rasterMs = ElapsedMs(&start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int stride;
+    uint32_t *pixels = X11Present_BackBuffer(present, &stride);
+
+    if (width == present->width && height == present->height) {
+        for (int y = 0; y < height; y++) {
+            pixelConvert(PIXEL_BGR24, PIXEL_XRGB8888, frame->internal.image.pixels + y * width, pixels + y * stride, width);
+        }
+    } else {
+        pixelConvert(PIXEL_BGR24, PIXEL_XRGB8888, frame->internal.image.pixels, frame->internalXRGB, width * height);
+        Upscaler_Upscale(frame->upscaler, frame->internalXRGB, width, height, width, pixels, stride);
+    }
+
+    char hud[64];
+    snprintf(hud, sizeof(hud), "%dx%d  raster %.2f ms  upscale %.2f ms", width, height, rasterMs, ElapsedMs(&start));
+    Font_DrawText(frame->font, (uint8_t *) pixels, 4, stride * 4, present->width, present->height,
+                  100, 80, hud, 0xFFFFFF, 255);
+
+    X11Present_Blit(present, 0, 0, present->width, present->height);
+
+    DynamicResolution_Update(&frame->resolution, rasterMs);
+    frame->angle += 0.02f;
+}
+
+// Frame clock for the animated mode
+int CreateFrameTimer(long intervalNs)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct itimerspec spec = {
+        .it_interval = { .tv_sec = 0, .tv_nsec = intervalNs },
+        .it_value = { .tv_sec = 0, .tv_nsec = intervalNs }
+    };
+    timerfd_settime(fd, 0, &spec, NULL);
+
+    return fd;
+}
+
+// Fires on every wall clock second, so the status bar changes right on time
+int CreateSecondTimer()
+{
+    int fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    struct itimerspec spec = {
+        .it_interval = { .tv_sec = 1, .tv_nsec = 0 },
+        .it_value = { .tv_sec = now.tv_sec + 1, .tv_nsec = 0 }
+    };
+    timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, NULL);
+
+    return fd;
+}
+
+int main(int argc, char **argv) {
 
     int screenWidth = 3840;
     int screenHeight = 2160;
+    int dynamicResolution = argc > 1 && strcmp(argv[1], "--dynres") == 0;
 
     setlocale(LC_ALL, "");
 
@@ -91,6 +278,9 @@ int main() {
                                        BlackPixel(display, screen_num),
                                        WhitePixel(display, screen_num));
     
+    // The frame covers the whole window, let the server skip clearing exposed areas
+    XSetWindowBackgroundPixmap(display, win, None);
+
     // Select input events
     XSelectInput(display, win, ExposureMask | KeyPressMask | StructureNotifyMask);
 
@@ -107,48 +297,138 @@ int main() {
     
     statusBar = StatusBar_Create(display, win);
 
+    // Render a frame to show in the window
+    OBJ_Model model;
+
+    OBJ_Model_init(&model);
+    OBJ_Model_parse("model/cube.obj", &model);
+
+    TGAImage frame = tgaCreateImage(screenWidth, screenHeight);
+
+    Arena modelArena = Arena_Create(MODEL_ARENA_RESERVE);
+    Mesh mesh = OBJ_Model_mesh(&model, &modelArena);
+    drawMesh(&mesh, &frame, red);
+
+    X11Present *present = X11Present_Create(display, win, screenWidth, screenHeight);
+    if (present == NULL) {
+        fprintf(stderr, "Cannot create presenter\n");
+        return 1;
+    }
+
+    int timer = CreateSecondTimer();
+    if (timer < 0) {
+        perror("Cannot create timer");
+        return 1;
+    }
+
+    // --dynres animates a turntable at 60 Hz with dynamic resolution
+    DynamicFrame *dynamicFrame = NULL;
+    int frameTimer = -1;
+    if (dynamicResolution) {
+        dynamicFrame = DynamicFrame_Create(screenWidth, screenHeight);
+        frameTimer = CreateFrameTimer(1000000000L / 60);
+    }
+
+    struct pollfd fds[3] = {
+        { .fd = ConnectionNumber(display), .events = POLLIN },
+        { .fd = timer, .events = POLLIN },
+        { .fd = frameTimer, .events = POLLIN }
+    };
+
+    XRectangle statusBounds = StatusBar_Bounds(statusBar);
+    StatusBar_Update(statusBar);
+
     // Event loop
     XEvent ev;
-    while (1) {
-        XNextEvent(display, &ev);
-	
-    	switch (ev.type) {
-            case KeyPress:
-    		    KeySym key = XLookupKeysym(&ev.xkey, 0);
-    		    
-                if (key == XK_Escape) {
-    		    	XDestroyWindow(display, win);
-    			    XCloseDisplay(display);
-    			    return 0;
-    		    }
-    
-    		    if (key == XK_c) {
-    			    Window win2 = XCreateSimpleWindow(
-                            display, 
-                            root, 
-                            200, 200, 
-                            400, 200, 
-                            2,
-    					    BlackPixel(display, screen_num),
-    					    WhitePixel(display, screen_num));
-    			    XMapRaised(display, win2);
-    			    XFlush(display);
-    		    }
-                break;
-    
-    	    case Expose:
-    		    StatusBar_DrawCurrentTime(statusBar);
-                XFlush(display);
-                break;
-    
-    	    case MapNotify:
-    	       XClearWindow(display, win);
-       	       XFlush(display);
-    	       break;	   
-    	}
+    int running = 1;
+    while (running) {
+        XRectangle damage = { 0 };
+
+        // Drain everything already queued or readable before going back to sleep
+        while (XPending(display)) {
+            XNextEvent(display, &ev);
+
+            if (X11Present_HandleEvent(present, &ev)) {
+                continue;
+            }
+
+            switch (ev.type) {
+                case KeyPress: {
+                    KeySym key = XLookupKeysym(&ev.xkey, 0);
+
+                    if (key == XK_Escape) {
+                        running = 0;
+                    }
+
+                    if (key == XK_c) {
+                        Window win2 = XCreateSimpleWindow(
+                                display,
+                                root,
+                                200, 200,
+                                400, 200,
+                                2,
+                                BlackPixel(display, screen_num),
+                                WhitePixel(display, screen_num));
+                        XMapRaised(display, win2);
+                    }
+                    break;
+                }
+
+                case Expose:
+                    // Exposes are coalesced into one damage region for this batch
+                    if (ev.xexpose.window == win) {
+                        Damage_Add(&damage, ev.xexpose.x, ev.xexpose.y, ev.xexpose.width, ev.xexpose.height);
+                    }
+                    break;
+            }
+        }
+
+        if (!running) break;
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t expirations;
+            read(timer, &expirations, sizeof(expirations));
+
+            if (StatusBar_Update(statusBar)) {
+                Damage_Add(&damage, statusBounds.x, statusBounds.y, statusBounds.width, statusBounds.height);
+            }
+        }
+
+        if (dynamicResolution) {
+            // Exposed areas are repainted by the next animation frame,
+            // missed ticks are dropped so the next frame starts on time
+            if (fds[2].revents & POLLIN) {
+                uint64_t expirations;
+                read(frameTimer, &expirations, sizeof(expirations));
+
+                DynamicFrame_Present(dynamicFrame, &mesh, present);
+                StatusBar_Draw(statusBar);
+            }
+        } else if (damage.width && damage.height) {
+            PresentFrame(present, &frame, &damage);
+
+            if (Damage_Intersects(&damage, &statusBounds)) {
+                StatusBar_Draw(statusBar);
+            }
+        }
+
+        XFlush(display);
+
+        // Waiting for ShmCompletion in X11Present_BackBuffer reads whatever
+        // else arrived into Xlib's queue, where poll on the socket can't see
+        // it. Only check the timers then, the loop drains the queue next.
+        int timeout = QLength(display) > 0 ? 0 : -1;
+
+        if (poll(fds, dynamicResolution ? 3 : 2, timeout) < 0) {
+            perror("poll");
+            break;
+        }
     }
 
     // Cleanup
+    close(timer);
+    if (frameTimer >= 0) close(frameTimer);
+    X11Present_Destroy(present);
     XDestroyWindow(display, win);
     XCloseDisplay(display);
     return 0;